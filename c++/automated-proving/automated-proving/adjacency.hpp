@@ -0,0 +1,153 @@
+#ifndef adjacency_hpp
+#define adjacency_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <new>
+
+/*
+ * A set of pointers stored contiguously in insertion order, with inline storage for the first N entries.
+ * Small sets are searched linearly; once a set grows beyond THRESHOLD entries, the entries are also kept
+ * in an open-addressing hash table (linear probing, at most half full), so that inserting and looking up stay O(1).
+ * Appending never reorders the existing entries, so iterating by index stays valid while the set grows.
+ */
+template<class T, size_t N = 4>
+class Adjacency {
+    
+    static const size_t THRESHOLD = 16;
+    
+    T* data;
+    uint32_t count, capacity;
+    T local[N];
+    std::vector<T> table;   // Empty slots are null, and the size is a power of two (or zero for small sets)
+    
+    Adjacency(const Adjacency&) = delete;
+    Adjacency& operator=(const Adjacency&) = delete;
+    
+    void grow() {
+        uint32_t c = capacity * 2;
+        T* d = (T*) std::malloc(c * sizeof(T));
+        if(d == nullptr)
+            throw std::bad_alloc();
+        std::memcpy(d, data, count * sizeof(T));
+        if(data != local)
+            std::free(data);
+        data = d;
+        capacity = c;
+    }
+    
+    size_t home(T x) const {
+        uint64_t h = (uint64_t) (uintptr_t) x * 0x9e3779b97f4a7c15ull;
+        return (size_t) (h ^ (h >> 32)) & (table.size() - 1);
+    }
+    
+    // The slot of x, or the empty slot where it would go
+    size_t find(T x) const {
+        size_t i = home(x);
+        while(table[i] != nullptr && table[i] != x)
+            i = (i + 1) & (table.size() - 1);
+        return i;
+    }
+    
+    void rehash(size_t n) {
+        table.assign(n, nullptr);
+        for(uint32_t i = 0;i < count; ++i)
+            table[find(data[i])] = data[i];
+    }
+    
+    // Removes x from the table, moving the entries after it back so that every probe sequence stays unbroken
+    void unhash(T x) {
+        size_t mask = table.size() - 1;
+        size_t i = find(x);
+        for(size_t j = (i + 1) & mask; table[j] != nullptr; j = (j + 1) & mask) {
+            // The entry at j can fill the hole at i unless its home lies cyclically in (i, j]
+            size_t k = home(table[j]);
+            if(((j - k) & mask) >= ((j - i) & mask)) {
+                table[i] = table[j];
+                i = j;
+            }
+        }
+        table[i] = nullptr;
+    }
+    
+public:
+    
+    Adjacency() : data(local), count(0), capacity(N) {}
+    ~Adjacency() { if(data != local) std::free(data); }
+    
+    typedef T* iterator;
+    iterator begin() const { return data; }
+    iterator end() const { return data + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T operator[](size_t i) const { return data[i]; }
+    
+    bool contains(T x) const {
+        if(count <= THRESHOLD)
+            return std::find(data, data + count, x) != data + count;
+        return table[find(x)] != nullptr;
+    }
+    
+    bool insert(T x) {
+        if(contains(x))
+            return false;
+        
+        if(count == capacity)
+            grow();
+        data[count++] = x;
+        
+        // Maintain the hash table for large sets
+        if(count > THRESHOLD) {
+            if(2 * (size_t) count > table.size())
+                rehash(table.empty() ? 4 * THRESHOLD : 2 * table.size());
+            else
+                table[find(x)] = x;
+        }
+        return true;
+    }
+    
+    bool erase(T x) {
+        // Search from the back, as the most recently inserted entries are the ones usually erased
+        T* pos = data + count;
+        while(pos != data && *(pos - 1) != x)
+            --pos;
+        if(pos == data)
+            return false;
+        --pos;
+        
+        std::memmove(pos, pos + 1, (data + count - pos - 1) * sizeof(T));
+        --count;
+        if(count > THRESHOLD)
+            unhash(x);
+        else
+            table.clear();
+        return true;
+    }
+    
+    void clear() {
+        count = 0;
+        table.clear();
+    }
+    
+    // Replaces all entries at once, without checking for duplicates (the entries have to be distinct already)
+    void assign(const T* first, size_t n) {
+        clear();
+        while(capacity < n)
+            grow();
+        std::memcpy(data, first, n * sizeof(T));
+        count = (uint32_t) n;
+        if(count > THRESHOLD) {
+            size_t slots = 4 * THRESHOLD;
+            while(slots < 2 * (size_t) count)
+                slots *= 2;
+            rehash(slots);
+        }
+    }
+    
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "arena.hpp"
+#include <cstdlib>
+
+Arena::Arena(size_t size) : blockSize(size), current(nullptr), left(0) {
+}
+
+Arena::~Arena() {
+    // Release all blocks at once
+    for(auto b : blocks)
+        std::free(b);
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    // Align the bump pointer
+    size_t padding = (align - ((size_t) current & (align - 1))) & (align - 1);
+    
+    // If the current block is too small, start a new one (large requests get a block of their own)
+    if(current == nullptr || padding + size > left) {
+        size_t n = size + align > blockSize ? size + align : blockSize;
+        char* b = (char*) std::malloc(n);
+        if(b == nullptr)
+            throw std::bad_alloc();
+        blocks.push_back(b);
+        current = b;
+        left = n;
+        padding = (align - ((size_t) current & (align - 1))) & (align - 1);
+    }
+    
+    void* p = current + padding;
+    current += padding + size;
+    left -= padding + size;
+    return p;
+}
+
+Arena::Mark Arena::mark() const {
+    return Mark { blocks.size(), current, left };
+}
+
+// The objects allocated after the mark must have been destructed already
+void Arena::release(const Mark& m) {
+    while(blocks.size() > m.blocks) {
+        std::free(blocks.back());
+        blocks.pop_back();
+    }
+    current = m.current;
+    left = m.left;
+}
@@ -0,0 +1,44 @@
+#ifndef arena_hpp
+#define arena_hpp
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <new>
+
+class Arena {
+
+    const size_t blockSize;
+    
+    std::vector<char*> blocks;
+    char* current;
+    size_t left;
+    
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    
+public:
+    
+    // A position of the bump pointer, to release everything allocated after it at once
+    struct Mark {
+        size_t blocks;
+        char* current;
+        size_t left;
+    };
+    
+    Arena(size_t = 64 * 1024);
+    ~Arena();
+    
+    void* allocate(size_t, size_t);
+    
+    Mark mark() const;
+    void release(const Mark&);
+    
+    template<class T, class... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+    
+};
+
+#endif
@@ -0,0 +1,19 @@
+#include <cstdlib>
+#include <cstring>
+#include "benchmarks.hpp"
+
+int main(int argc, const char * argv[]) {
+    
+    // The optional number scales the size of all workloads, and --stats prints the search statistics
+    size_t scale = 1;
+    bool stats = false;
+    for(int i = 1;i < argc; ++i) {
+        if(std::strcmp(argv[i], "--stats") == 0)
+            stats = true;
+        else if(std::atoi(argv[i]) > 0)
+            scale = (size_t) std::atoi(argv[i]);
+    }
+    Benchmarks::run(scale, stats);
+    
+    return 0;
+}
@@ -0,0 +1,497 @@
+#include "benchmarks.hpp"
+#include "saturation.hpp"
+#include "store.hpp"
+#include "service.hpp"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <thread>
+#include <sys/resource.h>
+
+bool Benchmarks::dumpStats = false;
+
+void Benchmarks::run(size_t scale, bool stats) {
+    dumpStats = stats;
+    std::cout << std::left << std::setw(36) << "benchmark" << std::right
+              << std::setw(8) << "ops" << std::setw(8) << "true"
+              << std::setw(12) << "total(ms)" << std::setw(12) << "ops/s"
+              << std::setw(12) << "p50(us)" << std::setw(12) << "p90(us)" << std::setw(12) << "p99(us)" << std::setw(14) << "max(us)"
+              << std::setw(10) << "nodes" << std::setw(10) << "peak(MB)" << std::endl;
+    
+    chain(10000 * scale);
+    wideProducts(64 * scale);
+    nestedExponentials(8 * scale);
+    pigeonhole(1 + scale);
+    randomTheory(16 * scale, 1);
+    logicPrimer(10 * scale);
+    image(100000 * scale);
+    service(16 * scale);
+    bulk(2000 * scale);
+}
+
+// ----------------------------------------------------------------
+
+Benchmarks::Measurement::Measurement(std::string n) : name(n), total(0), nodes(0), succeeded(0) {
+}
+
+void Benchmarks::Measurement::report(Heyting& h) {
+    nodes = h.size();
+    size_t ops = samples.size();
+    std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(8) << ops << std::setw(8) << succeeded
+              << std::setw(12) << total / 1000.0 << std::setw(12) << (total > 0 ? ops / (total / 1e6) : 0.0)
+              << std::setw(12) << percentile(samples, 0.50) << std::setw(12) << percentile(samples, 0.90)
+              << std::setw(12) << percentile(samples, 0.99) << std::setw(14) << percentile(samples, 1.00)
+              << std::setw(10) << nodes << std::setw(10) << peakMemory() << std::endl;
+    
+    // The statistics go on a line of their own, as a JSON object
+    if(dumpStats && !stats.nodes.empty()) {
+        std::cout << "  stats: ";
+        stats.dump(std::cout);
+        std::cout << std::endl;
+    }
+}
+
+double Benchmarks::percentile(std::vector<double>& samples, double p) {
+    if(samples.empty())
+        return 0;
+    
+    size_t k = (size_t) (p * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+double Benchmarks::peakMemory() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+}
+
+// ----------------------------------------------------------------
+
+void Benchmarks::chain(size_t n) {
+    /*
+     * A single chain of implications x_0 => x_1 => ... => x_n
+     */
+    Heyting h;
+    std::mt19937 random(0);
+    
+    std::vector<Heyting::Element*> x;
+    for(size_t i = 0;i <= n; ++i)
+        x.push_back(h.createElement());
+    
+    Measurement put("chain: putArrow");
+    for(size_t i = 0;i < n; ++i)
+        put.time([&]() { h.putArrow(x[i], x[i + 1]); return true; });
+    put.report(h);
+    
+    Measurement positive("chain: isArrow (forward)");
+    Measurement negative("chain: isArrow (backward)");
+    for(int k = 0;k < 1000; ++k) {
+        size_t i = random() % (n + 1), j = random() % (n + 1);
+        if(i > j)
+            std::swap(i, j);
+        positive.time([&]() { return h.isArrow(x[i], x[j]); });
+        negative.time([&]() { return h.isArrow(x[j], x[i]); });
+    }
+    positive.report(h);
+    negative.report(h);
+    
+    // The reachability index needs 2n^2 bits, so only build it for moderate sizes
+    if(n <= 20000) {
+        Measurement index("chain: build reachability index");
+        index.time([&]() { h.indexReachability(true); return true; });
+        index.report(h);
+        
+        Measurement indexed("chain: isArrow (indexed)");
+        for(int k = 0;k < 1000; ++k) {
+            size_t i = random() % (n + 1), j = random() % (n + 1);
+            indexed.time([&]() { return h.isArrow(x[i], x[j]); });
+        }
+        indexed.report(h);
+    }
+}
+
+void Benchmarks::wideProducts(size_t k) {
+    /*
+     * Given a_i => b_i for i = 1, ..., k
+     *
+     * Prove:
+     *  (a_1 ^ ... ^ a_k) => (b_1 ^ ... ^ b_k)
+     *  (a_1 v ... v a_k) => (b_1 v ... v b_k)
+     *  (a_1 ^ ... ^ a_k) => (product of a random subset of the a_i)
+     */
+    Heyting h;
+    std::mt19937 random(0);
+    
+    std::vector<Heyting::Element*> a, b;
+    for(size_t i = 0;i < k; ++i) {
+        a.push_back(h.createElement("a" + std::to_string(i)));
+        b.push_back(h.createElement("b" + std::to_string(i)));
+        h.putArrow(a[i], b[i]);
+    }
+    
+    auto subset = [&](const std::vector<Heyting::Element*>& v) {
+        std::set<Heyting::Element*> s;
+        for(auto e : v)
+            if(random() % 2)
+                s.insert(e);
+        return s;
+    };
+    
+    Measurement intern("wide: intern product (new)");
+    Measurement lookup("wide: intern product (existing)");
+    std::vector<std::set<Heyting::Element*>> subsets;
+    for(int i = 0;i < 1000; ++i)
+        subsets.push_back(subset(a));
+    for(auto& s : subsets)
+        intern.time([&]() { return h.product(s) != nullptr; });
+    for(auto& s : subsets)
+        lookup.time([&]() { return h.product(s) != nullptr; });
+    intern.report(h);
+    lookup.report(h);
+    
+    Prover prover(h);
+    prover.setVerbose(false);
+    std::set<Heyting::Element*> all_a(a.begin(), a.end()), all_b(b.begin(), b.end());
+    
+    Measurement products("wide: implication (products)");
+    products.prove(prover, h.product(all_a), h.product(all_b));
+    products.report(h);
+    
+    Measurement coproducts("wide: implication (coproducts)");
+    coproducts.prove(prover, h.coproduct(all_a), h.coproduct(all_b));
+    coproducts.report(h);
+    
+    Measurement projections("wide: implication (projections)");
+    for(auto& s : subsets)
+        projections.prove(prover, h.product(all_a), h.product(s));
+    projections.report(h);
+}
+
+void Benchmarks::nestedExponentials(size_t d) {
+    /*
+     * Given True => a_i for i = 1, ..., d and True => (a_1 => (a_2 => ... (a_d => b)))
+     *
+     * Prove:
+     *  True => b
+     */
+    Heyting h;
+    
+    std::vector<Heyting::Element*> a;
+    for(size_t i = 0;i < d; ++i)
+        a.push_back(h.createElement("a" + std::to_string(i)));
+    auto b = h.createElement("b");
+    
+    Measurement intern("nested: intern exponential");
+    Heyting::Element* e = b;
+    for(size_t i = d;i-- > 0;)
+        intern.time([&]() { e = h.exponential(e, a[i]); return true; });
+    intern.report(h);
+    
+    h.putArrow(h.True, e);
+    for(auto x : a)
+        h.putArrow(h.True, x);
+    
+    Prover prover(h);
+    prover.setVerbose(false);
+    Measurement modusPonens("nested: implication (modus ponens)");
+    modusPonens.prove(prover, h.True, b);
+    modusPonens.report(h);
+}
+
+void Benchmarks::pigeonhole(size_t n) {
+    /*
+     * Pigeonhole principle with n + 1 pigeons and n holes (p_ij: pigeon i sits in hole j)
+     *
+     * Given:
+     *  True => (p_i1 v ... v p_in) for all i
+     *  (p_ij ^ p_kj) => False for all i != k
+     *
+     * Prove:
+     *  True => False
+     */
+    Heyting h;
+    
+    std::vector<std::vector<Heyting::Element*>> p(n + 1);
+    for(size_t i = 0;i <= n; ++i)
+        for(size_t j = 0;j < n; ++j)
+            p[i].push_back(h.createElement("p" + std::to_string(i) + "_" + std::to_string(j)));
+    
+    for(size_t i = 0;i <= n; ++i)
+        h.putArrow(h.True, h.coproduct(std::set<Heyting::Element*>(p[i].begin(), p[i].end())));
+    for(size_t j = 0;j < n; ++j)
+        for(size_t i = 0;i <= n; ++i)
+            for(size_t k = i + 1;k <= n; ++k)
+                h.putArrow(h.product({ p[i][j], p[k][j] }), h.False);
+    
+    Prover prover(h);
+    prover.setVerbose(false);
+    Measurement m("pigeonhole: implication (n = " + std::to_string(n) + ")");
+    m.prove(prover, h.True, h.False);
+    m.report(h);
+}
+
+void Benchmarks::randomTheory(size_t n, unsigned seed) {
+    /*
+     * A random propositional theory over n atoms, with 3n hypotheses of the form (l_1 ^ l_2) => l_3,
+     * where every literal l_i is an atom or (with probability 1/5) its negation, and 200 random goals l_1 => l_2
+     *
+     * (Hypotheses with coproducts as codomain make the search blow up already for a handful of atoms)
+     *
+     * The goals are posed one by one, then once more as a single batch against a fresh copy of the theory,
+     * then answered by isArrow alone after saturating another fresh copy, and finally posed one by one again
+     * with classical refutation, which skips the search for the goals that have a countermodel
+     */
+    for(int mode = 0;mode < 4; ++mode) {
+        Heyting h;
+        std::mt19937 random(seed);
+        
+        std::vector<Heyting::Element*> atoms;
+        for(size_t i = 0;i < n; ++i)
+            atoms.push_back(h.createElement("p" + std::to_string(i)));
+        
+        auto literal = [&]() {
+            auto x = atoms[random() % n];
+            return (random() % 5 == 0) ? h.negate(x) : x;
+        };
+        
+        for(size_t i = 0;i < 3 * n; ++i) {
+            auto l1 = literal(), l2 = literal(), l3 = literal();
+            h.putArrow(h.product({ l1, l2 }), l3);
+        }
+        
+        std::vector<Prover::Goal> goals;
+        for(int i = 0;i < 200; ++i) {
+            auto x = literal(), y = literal();
+            goals.push_back(Prover::Goal(x, y));
+        }
+        
+        Prover prover(h);
+        prover.setVerbose(false);
+        if(mode == 0) {
+            Measurement m("random: implication (n = " + std::to_string(n) + ")");
+            for(auto& goal : goals)
+                m.prove(prover, goal.first, goal.second);
+            m.report(h);
+        }
+        else if(mode == 1) {
+            // A single operation, of which "true" counts the goals that were shown
+            Measurement m("random: implications (n = " + std::to_string(n) + ")");
+            std::vector<bool> shown;
+            m.time([&]() { shown = prover.implications(goals, m.stats); return false; });
+            m.succeeded = std::count(shown.begin(), shown.end(), true);
+            m.report(h);
+        }
+        else if(mode == 2) {
+            Saturation saturation(h);
+            Measurement saturate("random: saturate (n = " + std::to_string(n) + ")");
+            saturate.time([&]() { saturation.saturate(); return true; });
+            saturate.report(h);
+            
+            Measurement m("random: isArrow after saturate");
+            for(auto& goal : goals)
+                m.time([&]() { return h.isArrow(goal.first, goal.second); });
+            m.report(h);
+        }
+        else {
+            prover.setRefutation(true);
+            Measurement m("random: implication, refuting (n = " + std::to_string(n) + ")");
+            for(auto& goal : goals)
+                m.prove(prover, goal.first, goal.second);
+            m.report(h);
+        }
+    }
+}
+
+void Benchmarks::logicPrimer(size_t k) {
+    /*
+     * The problems of exercise 1.4.2 of Logic Primer (see test_9), each posed k times over fresh atoms,
+     * all in the same Heyting algebra
+     */
+    Heyting h;
+    Prover prover(h);
+    prover.setVerbose(false);
+    
+    Measurement m("primer: implication (k = " + std::to_string(k) + ")");
+    for(size_t i = 0;i < k; ++i) {
+        std::string suffix = std::to_string(i);
+        auto P = h.createElement("P" + suffix);
+        auto Q = h.createElement("Q" + suffix);
+        auto R = h.createElement("R" + suffix);
+        auto S = h.createElement("S" + suffix);
+        auto T = h.createElement("T" + suffix);
+        auto U = h.createElement("U" + suffix);
+        auto t = h.True;
+        
+        // Every problem is a list of hypotheses and a goal True => y
+        std::vector<std::pair<std::vector<std::pair<Heyting::Element*, Heyting::Element*>>, Heyting::Element*>> problems = {
+            { { { t, h.coproduct({ P, h.negate(R) }) }, { h.negate(R), S }, { t, h.negate(P) } }, S },
+            { { { P, h.negate(Q) }, { h.coproduct({ h.negate(Q), R }), h.negate(S) }, { t, h.product({ P, T }) } }, h.negate(S) },
+            { { { t, h.product({ P, Q, R }) }, { h.product({ P, R }), h.negate(S) }, { t, h.coproduct({ S, T }) } }, T },
+            { { { P, Q }, { P, R }, { t, P } }, h.product({ Q, R }) },
+            { { { t, P }, { t, h.coproduct({ Q, R }) }, { t, h.coproduct({ h.negate(R), S }) }, { t, h.negate(Q) } }, h.product({ P, S }) },
+            { { { h.product({ h.exponential(P, Q), h.exponential(Q, P) }), R }, { t, h.exponential(P, Q) }, { t, h.exponential(Q, P) } }, R },
+            { { { h.negate(P), h.product({ Q, R }) }, { h.coproduct({ h.negate(P), S }), h.negate(T) }, { t, h.product({ U, h.negate(P) }) } }, h.product({ U, R, h.negate(T) }) }
+        };
+        
+        for(auto& problem : problems) {
+            for(auto& arrow : problem.first)
+                h.putArrow(arrow.first, arrow.second);
+            m.prove(prover, t, problem.second);
+        }
+    }
+    m.report(h);
+}
+
+void Benchmarks::image(size_t n) {
+    /*
+     * An algebra of n random products, coproducts and exponentials over n / 10 atoms, with an arrow from each of them,
+     * built through the interface, saved as an image, and loaded again
+     */
+    Heyting h;
+    std::mt19937 random(0);
+    std::vector<Heyting::Element*> x;
+    
+    Measurement build("image: build (n = " + std::to_string(n) + ")");
+    build.time([&]() {
+        for(size_t i = 0;i < n / 10; ++i)
+            x.push_back(h.createElement("p" + std::to_string(i)));
+        while(x.size() < n) {
+            auto a = x[random() % x.size()], b = x[random() % x.size()];
+            switch(random() % 3) {
+                case 0: x.push_back(h.product({ a, b })); break;
+                case 1: x.push_back(h.coproduct({ a, b })); break;
+                default: x.push_back(h.exponential(a, b)); break;
+            }
+            h.putArrow(x.back(), x[random() % x.size()]);
+        }
+        return true;
+    });
+    build.report(h);
+    
+    std::string path = "/tmp/automated-proving-benchmark.img";
+    Measurement save("image: save");
+    save.time([&]() { Store::save(h, path); return true; });
+    save.report(h);
+    
+    Heyting loaded;
+    Measurement load("image: load");
+    load.time([&]() { Store::load(loaded, path); return loaded.size() == h.size(); });
+    load.report(loaded);
+    std::remove(path.c_str());
+}
+
+void Benchmarks::service(size_t n) {
+    /*
+     * Hypotheses (a_i ^ c) => a_i+1 for i < n, and 1000 random goals (a_i ^ c) => a_j with |i - j| <= 3,
+     * answered one by one by a single prover, and then submitted by four client threads at once to a service
+     * with a worker per core (the latency of a goal in the service is the time from its submission to its answer)
+     */
+    for(int mode = 0;mode < 2; ++mode) {
+        Heyting h;
+        std::mt19937 random(1);
+        
+        auto c = h.createElement("c");
+        std::vector<Heyting::Element*> a;
+        for(size_t i = 0;i <= n; ++i)
+            a.push_back(h.createElement("a" + std::to_string(i)));
+        for(size_t i = 0;i < n; ++i)
+            h.putArrow(h.product({ a[i], c }), a[i + 1]);
+        
+        std::vector<Prover::Goal> goals;
+        for(int k = 0;k < 1000; ++k) {
+            size_t i = random() % (n + 1);
+            size_t j = std::min(n, std::max((size_t) 3, i + random() % 7) - 3);
+            goals.push_back(Prover::Goal(h.product({ a[i], c }), a[j]));
+        }
+        
+        if(mode == 0) {
+            Prover prover(h);
+            prover.setVerbose(false);
+            Measurement m("service: one prover (n = " + std::to_string(n) + ")");
+            for(auto& goal : goals)
+                m.prove(prover, goal.first, goal.second);
+            m.report(h);
+        }
+        else {
+            size_t workers = std::max(1u, std::thread::hardware_concurrency());
+            Measurement m("service: " + std::to_string(workers) + " workers (n = " + std::to_string(n) + ")");
+            m.samples.resize(goals.size());
+            std::atomic<size_t> succeeded(0);
+            
+            auto start = std::chrono::steady_clock::now();
+            {
+                Service service(h, workers, 64);
+                std::vector<std::thread> clients;
+                for(size_t t = 0;t < 4; ++t)
+                    clients.emplace_back([&, t]() {
+                        for(size_t i = t;i < goals.size(); i += 4) {
+                            auto submitted = std::chrono::steady_clock::now();
+                            service.submit(goals[i].first, goals[i].second, [&m, &succeeded, i, submitted](Prover::Result r) {
+                                m.samples[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - submitted).count();
+                                if(r == Prover::PROVED)
+                                    ++succeeded;
+                            });
+                        }
+                    });
+                for(auto& c : clients)
+                    c.join();
+                service.wait();
+            }
+            m.total = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            m.succeeded = succeeded;
+            m.report(h);
+        }
+    }
+}
+
+void Benchmarks::bulk(size_t n) {
+    /*
+     * 4n random arrows between n atoms, put one by one with the reachability index kept up to date,
+     * and then loaded in bulk with the index built once at the end, followed by 1000 random queries
+     */
+    for(int mode = 0;mode < 2; ++mode) {
+        Heyting h;
+        std::mt19937 random(2);
+        
+        std::vector<Heyting::Element*> x;
+        for(size_t i = 0;i < n; ++i)
+            x.push_back(h.createElement());
+        
+        std::vector<std::pair<size_t, size_t>> arrows;
+        for(size_t k = 0;k < 4 * n; ++k)
+            arrows.push_back(std::make_pair(random() % n, random() % n));
+        
+        if(mode == 0) {
+            h.indexReachability(true);
+            Measurement put("bulk: putArrow (indexed)");
+            for(auto& a : arrows)
+                put.time([&]() { h.putArrow(x[a.first], x[a.second]); return true; });
+            put.report(h);
+        }
+        else {
+            Measurement load("bulk: load and build index");
+            load.time([&]() {
+                Heyting::Bulk bulk(h);
+                for(auto& a : arrows)
+                    h.putArrow(x[a.first], x[a.second]);
+                return true;
+            });
+            load.report(h);
+        }
+        
+        Measurement query(mode == 0 ? "bulk: isArrow (incremental index)" : "bulk: isArrow (bulk index)");
+        for(int k = 0;k < 1000; ++k) {
+            size_t i = random() % n, j = random() % n;
+            query.time([&]() { return h.isArrow(x[i], x[j]); });
+        }
+        query.report(h);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef benchmarks_hpp
+#define benchmarks_hpp
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include "heyting.hpp"
+#include "prover.hpp"
+
+class Benchmarks {
+
+    /* Measurements */
+    struct Measurement {
+        std::string name;
+        std::vector<double> samples; // Latency of every operation, in microseconds
+        double total;                // Wall-clock time of the whole run, in microseconds
+        size_t nodes;                // Number of elements in the Heyting algebra afterwards
+        size_t succeeded;            // Number of operations that returned true
+        Prover::Stats stats;         // Search statistics, summed over all implications
+        
+        Measurement(std::string);
+        
+        template<class F>
+        void time(F f) {
+            auto start = std::chrono::steady_clock::now();
+            if(f())
+                ++succeeded;
+            auto end = std::chrono::steady_clock::now();
+            double us = std::chrono::duration<double, std::micro>(end - start).count();
+            samples.push_back(us);
+            total += us;
+        }
+        
+        // Times a single implication, and adds its search statistics
+        void prove(Prover& prover, Heyting::Element* x, Heyting::Element* y) {
+            Prover::Stats s;
+            time([&]() { return prover.implication(x, y, s); });
+            stats += s;
+        }
+        
+        void report(Heyting&);
+    };
+    
+    static bool dumpStats;
+    
+    /* Workload generators */
+    static void chain(size_t);
+    static void wideProducts(size_t);
+    static void nestedExponentials(size_t);
+    static void pigeonhole(size_t);
+    static void randomTheory(size_t, unsigned);
+    static void logicPrimer(size_t);
+    static void image(size_t);
+    static void service(size_t);
+    static void bulk(size_t);
+    
+    static double percentile(std::vector<double>&, double);
+    static double peakMemory();
+    
+public:
+    
+    static void run(size_t, bool = false);
+    
+};
+
+#endif
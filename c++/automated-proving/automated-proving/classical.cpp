@@ -0,0 +1,136 @@
+#include "classical.hpp"
+
+Classical::Classical(Heyting& h, uint64_t c) : heyting(h), conflicts(c), generation(h.generation()), version(0), reclaims(h.reclaims()), elements(0), repeated(0) {
+    reset();
+}
+
+void Classical::reset() {
+    solver = Solver();
+    elements = 0;
+    variables.clear();
+    arrows.clear();
+    toFalse.clear();
+    repeated = 0;
+    version = heyting.version() - 1;
+}
+
+bool Classical::refutes(Heyting::Element* x, Heyting::Element* y) {
+    {
+        Heyting::Lock lock(heyting, false);
+        update();
+    }
+    return solver.solve({ literal(x), literal(y, true) }, conflicts) == Solver::SATISFIABLE;
+}
+
+// Takes the elements and arrows into account that were added since the last query
+void Classical::update() {
+    if(generation != heyting.generation()) {
+        generation = heyting.generation();
+        reset();
+    }
+    else if(reclaims != heyting.reclaims())
+        prune();
+    reclaims = heyting.reclaims();
+    // (new elements only change the version if they come with arrows)
+    size_t n = heyting.size();
+    if(version == heyting.version() && elements == n)
+        return;
+    version = heyting.version();
+    
+    variables.resize(n);
+    for(;elements < n; ++elements) {
+        variables[elements] = solver.addVariable();
+        define(heyting.element((Heyting::Id) elements));
+    }
+    arrows.resize(n, 0);
+    toFalse.resize(n, false);
+    
+    // The same arrows as Saturation takes into account: the ones stored at True and False themselves are left out,
+    // just like clearArrows leaves them
+    for(Heyting::Id i = 0;i < n; ++i) {
+        auto y = heyting.element(i);
+        if(y == heyting.True || y == heyting.False)
+            continue;
+        
+        for(;arrows[i] < y->arrowsFrom.size(); ++arrows[i])
+            solver.addClause({ literal(y->arrowsFrom[arrows[i]], true), literal(y) });
+        if(!toFalse[i] && y->arrowsTo.contains(heyting.False)) {
+            solver.addClause({ literal(y, true) });
+            toFalse[i] = true;
+        }
+    }
+}
+
+// After child contexts were reclaimed, the elements from the first one created since on are defined again, and the arrows
+// to the ones that lost some are added again (all of them, as it is not known which ones are left)
+void Classical::prune() {
+    size_t n = std::min(elements, heyting.size());
+    for(size_t i = 0;i < n; ++i) {
+        auto x = heyting.element((Heyting::Id) i);
+        if(x->created > reclaims) {
+            n = i;
+            break;
+        }
+        if(x->trimmed > reclaims) {
+            repeated += arrows[i];
+            arrows[i] = 0;
+        }
+    }
+    
+    // Once the variables that are no longer used and the repeated clauses outweigh the rest, the solver starts over
+    if(solver.size() - n + repeated > n) {
+        reset();
+        return;
+    }
+    elements = n;
+    variables.resize(n);
+    arrows.resize(n);
+    toFalse.resize(n);
+}
+
+void Classical::define(Heyting::Element* x) {
+    auto v = literal(x);
+    auto w = literal(x, true);
+    
+    if(x == heyting.True) {
+        solver.addClause({ v });
+        return;
+    }
+    if(x == heyting.False) {
+        solver.addClause({ w });
+        return;
+    }
+    
+    switch(x->type) {
+        case Heyting::Element::PRODUCT: {
+            std::vector<Solver::Literal> some = { v };
+            for(auto f : ((Heyting::Product*) x)->factors) {
+                solver.addClause({ w, literal(f) });
+                some.push_back(literal(f, true));
+            }
+            solver.addClause(some);
+            break;
+        }
+        
+        case Heyting::Element::COPRODUCT: {
+            std::vector<Solver::Literal> some = { w };
+            for(auto f : ((Heyting::Coproduct*) x)->factors) {
+                solver.addClause({ v, literal(f, true) });
+                some.push_back(literal(f));
+            }
+            solver.addClause(some);
+            break;
+        }
+        
+        case Heyting::Element::EXPONENTIAL: {
+            auto exp = (Heyting::Exponential*) x;
+            solver.addClause({ w, literal(exp->exponent, true), literal(exp->base) });
+            solver.addClause({ v, literal(exp->exponent) });
+            solver.addClause({ v, literal(exp->base, true) });
+            break;
+        }
+        
+        default:
+            break;
+    }
+}
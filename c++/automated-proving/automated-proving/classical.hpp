@@ -0,0 +1,53 @@
+#ifndef classical_hpp
+#define classical_hpp
+
+#include <vector>
+#include <cstdint>
+#include "heyting.hpp"
+#include "solver.hpp"
+
+/*
+ * Refutes implications by classical countermodels: every implication that can be shown in a Heyting algebra also holds
+ * in every two-valued valuation that respects its arrows, so if there is a valuation that respects all arrows and
+ * makes x true and y false, then x => y cannot be shown.
+ *
+ * Every element is a variable of a SAT solver, tied to its operands by the clauses of its definition
+ * (v <=> f_1 ^ ... ^ f_n for products, v <=> f_1 v ... v f_n for coproducts, v <=> (~e v b) for exponentials),
+ * True and False are fixed, and every arrow x => y is the clause ~x v y. A query only adds the elements and arrows
+ * that were added since the one before, and assumes x and ~y. Clearing the arrows (or rolling them back) starts over.
+ * Reclaiming a child context does not: the elements that were dropped keep their variables and clauses (which say
+ * nothing about the other variables that does not follow from the rest), and their ids get new variables.
+ */
+class Classical {
+
+    Heyting& heyting;
+    Solver solver;
+    const uint64_t conflicts;
+    
+    uint64_t generation;
+    uint64_t version;
+    uint64_t reclaims;
+    size_t elements;                            // Number of elements of the algebra taken into account so far
+    std::vector<Solver::Variable> variables;    // For every element, its variable
+    std::vector<uint32_t> arrows;               // For every element, the number of arrows to it taken into account so far
+    std::vector<char> toFalse;                  // For every element, whether its arrow to False was taken into account
+    size_t repeated;                            // Clauses of arrows that were added again after a reclaim
+    
+    Solver::Literal literal(Heyting::Element* x, bool negative = false) const { return Solver::literal(variables[x->id], negative); }
+    
+    void reset();
+    void prune();
+    void update();
+    void define(Heyting::Element*);
+    
+public:
+    
+    // The number of conflicts after which a query gives up, and leaves the goal to the search
+    Classical(Heyting&, uint64_t = 10000);
+    
+    // True if there is a valuation that respects all arrows in which x is true and y is false
+    bool refutes(Heyting::Element*, Heyting::Element*);
+    
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "countermodels.hpp"
+#include <algorithm>
+
+Countermodels::Table::Table(Frame f, const std::vector<uint32_t>& a) : frame(f), worlds(a.size()), above(a), alive(true) {
+    // The up-sets are the sets of worlds that contain everything above each of their worlds
+    for(uint32_t set = 0;set < (1u << worlds); ++set) {
+        bool closed = true;
+        for(size_t w = 0;w < worlds; ++w)
+            if((set >> w & 1) && (above[w] & ~set) != 0)
+                closed = false;
+        if(closed)
+            upsets.push_back(set);
+    }
+}
+
+Countermodels::Countermodels(Heyting& h, size_t lanes) : heyting(h), words(lanes == 0 ? 1 : (lanes + 63) / 64), generation(h.generation()), reclaims(h.reclaims()) {
+    tables.emplace_back(CLASSICAL, std::vector<uint32_t>({ 0b1 }));
+    tables.emplace_back(CHAIN, std::vector<uint32_t>({ 0b11, 0b10 }));
+    tables.emplace_back(FORK, std::vector<uint32_t>({ 0b111, 0b010, 0b100 }));
+    reset();
+}
+
+void Countermodels::reset() {
+    elements = 0;
+    atoms = 0;
+    arrows.clear();
+    toFalse.clear();
+    for(auto& t : tables) {
+        t.values.clear();
+        t.valid.assign(words, ~(uint64_t) 0);
+        t.alive = true;
+    }
+    version = heyting.version() - 1;
+}
+
+Countermodels::Frame Countermodels::refutes(Heyting::Element* x, Heyting::Element* y) {
+    Heyting::Lock lock(heyting, false);
+    update();
+    
+    for(auto& t : tables)
+        for(size_t i = 0;i < words && t.alive; ++i) {
+            uint64_t outside = 0;
+            for(size_t w = 0;w < t.worlds; ++w)
+                outside |= value(t, x->id, w)[i] & ~value(t, y->id, w)[i];
+            if((outside & t.valid[i]) != 0)
+                return t.frame;
+        }
+    return NONE;
+}
+
+// Takes the elements and arrows into account that were added since the last query
+void Countermodels::update() {
+    if(generation != heyting.generation()) {
+        generation = heyting.generation();
+        reset();
+    }
+    else if(reclaims != heyting.reclaims())
+        prune();
+    reclaims = heyting.reclaims();
+    // (new elements only change the version if they come with arrows)
+    size_t n = heyting.size();
+    if(version == heyting.version() && elements == n)
+        return;
+    version = heyting.version();
+    
+    for(auto& t : tables)
+        if(t.alive)
+            t.values.resize(n * t.worlds * words);
+    for(;elements < n; ++elements) {
+        auto x = heyting.element((Heyting::Id) elements);
+        for(auto& t : tables)
+            if(t.alive)
+                evaluate(t, x);
+        if(x->type == Heyting::Element::ELEMENT && x != heyting.True && x != heyting.False)
+            ++atoms;
+    }
+    arrows.resize(n, 0);
+    toFalse.resize(n, false);
+    
+    // The same arrows as Classical takes into account
+    for(Heyting::Id i = 0;i < n; ++i) {
+        auto y = heyting.element(i);
+        if(y == heyting.True || y == heyting.False)
+            continue;
+        
+        for(;arrows[i] < y->arrowsFrom.size(); ++arrows[i])
+            for(auto& t : tables)
+                restrict(t, y->arrowsFrom[arrows[i]], y);
+        if(!toFalse[i] && y->arrowsTo.contains(heyting.False)) {
+            for(auto& t : tables)
+                restrict(t, y, heyting.False);
+            toFalse[i] = true;
+        }
+    }
+    
+    // Arrows only ever rule lanes out, so a table without lanes is done with until the arrows are cleared
+    for(auto& t : tables)
+        if(t.alive && std::find_if(t.valid.begin(), t.valid.end(), [](uint64_t word) { return word != 0; }) == t.valid.end()) {
+            t.alive = false;
+            std::vector<uint64_t>().swap(t.values);
+        }
+}
+
+// After child contexts were reclaimed, the elements from the first one created since on are evaluated again, and the arrows
+// to the ones that lost some are taken into account again (ruling the same lanes out twice does no harm)
+void Countermodels::prune() {
+    size_t n = std::min(elements, heyting.size());
+    atoms = 0;
+    for(size_t i = 0;i < n; ++i) {
+        auto x = heyting.element((Heyting::Id) i);
+        if(x->created > reclaims) {
+            n = i;
+            break;
+        }
+        if(x->trimmed > reclaims)
+            arrows[i] = 0;
+        if(x->type == Heyting::Element::ELEMENT && x != heyting.True && x != heyting.False)
+            ++atoms;
+    }
+    elements = n;
+    arrows.resize(n);
+    toFalse.resize(n);
+}
+
+// Drops the lanes in which x is not below y
+void Countermodels::restrict(Table& t, Heyting::Element* x, Heyting::Element* y) {
+    if(!t.alive)
+        return;
+    for(size_t w = 0;w < t.worlds; ++w) {
+        const uint64_t* a = value(t, x->id, w);
+        const uint64_t* b = value(t, y->id, w);
+        for(size_t i = 0;i < words; ++i)
+            t.valid[i] &= ~a[i] | b[i];
+    }
+}
+
+// The up-set of the given atom in the given lane: the first atoms run through all combinations, the others are random
+size_t Countermodels::choose(size_t atom, size_t lane, size_t upsets) const {
+    size_t period = 1, lanes = 64 * words;
+    for(size_t j = 0;j < atom && period <= lanes; ++j)
+        period *= upsets;
+    if(period * upsets <= lanes)
+        return lane / period % upsets;
+    
+    // SplitMix64, so that the choice only depends on the atom and the lane
+    uint64_t z = atom * 0x9e3779b97f4a7c15ull + lane + 1;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return (size_t) ((z ^ (z >> 31)) % upsets);
+}
+
+void Countermodels::evaluate(Table& t, Heyting::Element* x) {
+    // The up-set of an atom is chosen once per lane, for all worlds at the same time
+    if(x->type == Heyting::Element::ELEMENT && x != heyting.True && x != heyting.False) {
+        for(size_t w = 0;w < t.worlds; ++w)
+            std::fill(value(t, x->id, w), value(t, x->id, w) + words, 0);
+        for(size_t lane = 0;lane < 64 * words; ++lane) {
+            uint32_t upset = t.upsets[choose(atoms, lane, t.upsets.size())];
+            for(size_t w = 0;w < t.worlds; ++w)
+                value(t, x->id, w)[lane / 64] |= (uint64_t) (upset >> w & 1) << (lane % 64);
+        }
+        return;
+    }
+    
+    for(size_t w = 0;w < t.worlds; ++w) {
+        uint64_t* r = value(t, x->id, w);
+        
+        switch(x->type) {
+            case Heyting::Element::ELEMENT:
+                std::fill(r, r + words, x == heyting.True ? ~(uint64_t) 0 : 0);
+                break;
+            
+            case Heyting::Element::PRODUCT: {
+                std::fill(r, r + words, ~(uint64_t) 0);
+                for(auto f : ((Heyting::Product*) x)->factors) {
+                    const uint64_t* a = value(t, f->id, w);
+                    for(size_t i = 0;i < words; ++i)
+                        r[i] &= a[i];
+                }
+                break;
+            }
+            
+            case Heyting::Element::COPRODUCT: {
+                std::fill(r, r + words, 0);
+                for(auto f : ((Heyting::Coproduct*) x)->factors) {
+                    const uint64_t* a = value(t, f->id, w);
+                    for(size_t i = 0;i < words; ++i)
+                        r[i] |= a[i];
+                }
+                break;
+            }
+            
+            case Heyting::Element::EXPONENTIAL: {
+                // e => b holds at w if b holds at every world above w where e holds
+                auto exp = (Heyting::Exponential*) x;
+                std::fill(r, r + words, ~(uint64_t) 0);
+                for(size_t v = 0;v < t.worlds; ++v) {
+                    if(!(t.above[w] >> v & 1))
+                        continue;
+                    const uint64_t* e = value(t, exp->exponent->id, v);
+                    const uint64_t* b = value(t, exp->base->id, v);
+                    for(size_t i = 0;i < words; ++i)
+                        r[i] &= ~e[i] | b[i];
+                }
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef countermodels_hpp
+#define countermodels_hpp
+
+#include <vector>
+#include <cstdint>
+#include "heyting.hpp"
+
+/*
+ * Refutes implications by evaluating all elements in many small Kripke models at once. The up-sets of a finite poset
+ * of worlds form a Heyting algebra, so if some valuation of the atoms by up-sets respects all arrows and puts x outside
+ * of y at some world, then x => y cannot be shown.
+ *
+ * The frames are a single world (where the valuations are the rows of a truth table), a chain of two worlds
+ * (which refutes excluded middle and double negation elimination) and a root with two leaves (which refutes
+ * (p => q) v (q => p) as well). Every frame evaluates its valuations bit-parallel: lane i of every word is
+ * valuation i, and every element has a mask of lanes per world, computed from the masks of its operands.
+ * The first atoms run through all their combinations of up-sets, as far as the lanes go, and the others are chosen
+ * at random per lane (any lane that respects the arrows is a countermodel, whether or not the lanes are complete).
+ *
+ * Like Classical, a query only evaluates the elements and arrows that were added since the one before,
+ * and clearing the arrows (or rolling them back) starts over. Reclaiming a child context only evaluates the elements
+ * again whose ids were given to new ones (the arrows of the dropped elements may have ruled out lanes, which is safe,
+ * as every lane left is still a countermodel).
+ */
+class Countermodels {
+
+public:
+    
+    enum Frame { NONE, CLASSICAL, CHAIN, FORK };
+    
+private:
+    
+    struct Table {
+        Frame frame;
+        size_t worlds;
+        std::vector<uint32_t> above;    // For every world, the worlds at or above it, as a bit mask
+        std::vector<uint32_t> upsets;   // All up-sets, as bit masks of worlds
+        std::vector<uint64_t> values;   // For every element and world, the lanes in which the element holds there
+        std::vector<uint64_t> valid;    // The lanes in which all arrows hold
+        bool alive;                     // Whether there are any such lanes left
+        
+        Table(Frame, const std::vector<uint32_t>&);
+    };
+    
+    Heyting& heyting;
+    const size_t words;
+    std::vector<Table> tables;
+    
+    uint64_t generation;
+    uint64_t version;
+    uint64_t reclaims;
+    size_t elements;                // Number of elements of the algebra taken into account so far
+    size_t atoms;                   // Number of plain elements among them, besides True and False
+    std::vector<uint32_t> arrows;   // For every element, the number of arrows to it taken into account so far
+    std::vector<char> toFalse;      // For every element, whether its arrow to False was taken into account
+    
+    uint64_t* value(Table& t, Heyting::Id id, size_t world) { return &t.values[(id * t.worlds + world) * words]; }
+    
+    void reset();
+    void prune();
+    void update();
+    void evaluate(Table&, Heyting::Element*);
+    void restrict(Table&, Heyting::Element*, Heyting::Element*);
+    size_t choose(size_t, size_t, size_t) const;
+    
+public:
+    
+    // The number of valuations per frame, rounded up to a multiple of 64
+    // (the tables take lanes / 8 bytes per element and world, of which there are 6)
+    Countermodels(Heyting&, size_t = 1024);
+    
+    // The first frame with a valuation that respects all arrows and puts x outside of y, or NONE
+    Frame refutes(Heyting::Element*, Heyting::Element*);
+    
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef hashset_hpp
+#define hashset_hpp
+
+#include <cstdint>
+#include <functional>
+
+struct hash_set final {
+    template<class TSet>
+    size_t operator()(const TSet& s) const noexcept {
+        uintmax_t hash = s.size();
+        for(const auto& x : s)
+            hash = (hash ^ std::hash<typename TSet::value_type>{}(x)) * 0x100000001b3;
+        return std::hash<uintmax_t>{}(hash);
+    }
+};
+
+#endif
@@ -1,29 +1,130 @@
 #include "heyting.hpp"
+#include "hashset.hpp"
+#include <mutex>
+
+// Finalizer of SplitMix64, spreads the bits of a fingerprint
+static inline uint64_t mix(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+    return h ^ (h >> 31);
+}
+
+// Fingerprint of a plain element: FNV-1a of its name
+static uint64_t fingerprintOf(const std::string& name) {
+    uint64_t h = 0xcbf29ce484222325;
+    for(unsigned char c : name)
+        h = (h ^ c) * 0x100000001b3;
+    return mix(h);
+}
+
+// Fingerprint of a product or coproduct: the factors are combined in a way that does not depend on their order in memory
+static uint64_t fingerprintOf(Heyting::Element::Type type, const Span<Heyting::Element*>& factors) {
+    uint64_t h = 0;
+    for(auto f : factors)
+        h += mix(f->fingerprint);
+    return mix(h ^ ((uint64_t) type << 56));
+}
+
+static uint32_t depthOf(const Span<Heyting::Element*>& factors) {
+    uint32_t d = 0;
+    for(auto f : factors)
+        d = std::max(d, f->depth);
+    return d + 1;
+}
+
+static uint64_t sizeOf(const Span<Heyting::Element*>& factors) {
+    uint64_t n = 1;
+    for(auto f : factors)
+        n += f->size;
+    return n;
+}
+
+// The lock of the Heyting algebra held by the current thread (if any), so that nested calls do not lock again
+static thread_local Heyting* holder = nullptr;
+
+Heyting::Lock::Lock(Heyting& h, bool e) : heyting(h), previous(holder), locked(false), exclusive(e) {
+    if(heyting.concurrent.load() == 0 || holder == &heyting)
+        return;
+    
+    if(exclusive)
+        heyting.mutex.lock();
+    else
+        heyting.mutex.lock_shared();
+    holder = &heyting;
+    locked = true;
+}
+
+Heyting::Lock::~Lock() {
+    if(!locked)
+        return;
+    
+    holder = previous;
+    if(exclusive)
+        heyting.mutex.unlock();
+    else
+        heyting.mutex.unlock_shared();
+}
 
-Heyting::Heyting() : True(&T), False(&F) {
-    True->name = "True";
-    False->name = "False";
+Heyting::Heyting() : population(0), indexed(false), loading(false), currentVersion(0), currentGeneration(0), reclaimed(0), searchOrder(DEPTH_FIRST), logging(false), offset(0), serials(0), snapshots(0), clears(0), concurrent(0), True(createElement("True")), False(createElement("False")) {
 }
 
 Heyting::~Heyting() {
-    // Delete all elements
-    for(auto x : elements)
-        delete x;
+    // Destruct all elements, the arena releases their memory at once
+    for(auto x : elements) {
+        switch(x->type) {
+            case Element::ELEMENT: x->~Element(); break;
+            case Element::PRODUCT: ((Product*) x)->~Product(); break;
+            case Element::COPRODUCT: ((Coproduct*) x)->~Coproduct(); break;
+            case Element::EXPONENTIAL: ((Exponential*) x)->~Exponential(); break;
+        }
+    }
 }
 
-Heyting::Element* Heyting::createElement() {
-    auto x = new Heyting::Element();
+Heyting::Id Heyting::nextId() {
+    return (Id) elements.size();
+}
+
+void Heyting::registerElement(Heyting::Element* x) {
     elements.push_back(x);
+    population.store(elements.size(), std::memory_order_relaxed);
+    x->created = x->trimmed = reclaimed;
+    
+    // Structural arrows of products and coproducts count as new arrows
+    if(!x->arrowsTo.empty() || !x->arrowsFrom.empty())
+        ++currentVersion;
+    
+    // Add the element to the reachability index, together with the arrows it was constructed with
+    // (while bulk loading, endBulk indexes everything at once)
+    if(indexed && !loading) {
+        reachability.addVertex();
+        for(auto y : x->arrowsTo)
+            reachability.addEdge(x->id, y->id);
+        for(auto y : x->arrowsFrom)
+            reachability.addEdge(y->id, x->id);
+    }
+}
+
+Heyting::Element* Heyting::createElement() {
+    Lock lock(*this, true);
+    
+    // Without a name, the fingerprint can only go by the id
+    Id id = nextId();
+    auto x = arena.create<Element>(id, mix(id + 1));
+    registerElement(x);
     return x;
 }
 
 Heyting::Element* Heyting::createElement(std::string s) {
-    auto x = createElement();
-    x->name = s;
+    Lock lock(*this, true);
+    auto x = arena.create<Element>(nextId(), fingerprintOf(s));
+    registerElement(x);
+    names[x->id] = s;
     return x;
 }
 
-Heyting::Element* Heyting::product(std::set<Element*> factors) {
+Heyting::Element* Heyting::product(std::set<Element*> factors, bool create) {
+    Lock lock(*this, true);
+    
     // If any of the factors is False, we can just return False
     if(std::find(factors.begin(), factors.end(), False) != factors.end())
         return False;
@@ -43,7 +144,7 @@ Heyting::Element* Heyting::product(std::set<Element*> factors) {
     std::set<Element*> new_factors;
     for(auto f : factors) {
         if(f->type == Element::PRODUCT) {
-            auto other = ((Product*) f)->factors;
+            auto& other = ((Product*) f)->factors;
             new_factors.insert(other.begin(), other.end());
         }
         else {
@@ -51,23 +152,44 @@ Heyting::Element* Heyting::product(std::set<Element*> factors) {
         }
     }
     
+    return internProduct(new_factors, create);
+}
+
+// Looks up (or creates) the product of factors that are sorted already, and that are no products, True or False
+template<class C>
+Heyting::Element* Heyting::internProduct(const C& factors, bool create) {
     // If a product with these factors already exists, return it
-    for(auto x : elements) {
-        if(x->type != Element::PRODUCT)
-            continue;
-        
-        Product* prod = (Product*) x;
-        if(new_factors == prod->factors)
-            return prod;
+    size_t hash = hash_set{}(factors);
+    auto range = products.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it) {
+        if(it->second->factors.equals(factors))
+            return it->second;
     }
     
     // Finally, create the actual product, and return it
-    Product* prod = new Heyting::Product(new_factors);
-    elements.push_back(prod);
+    if(!create)
+        return nullptr;
+    auto without = (std::atomic<Element*>*) arena.allocate(factors.size() * sizeof(std::atomic<Element*>), alignof(std::atomic<Element*>));
+    for(size_t i = 0;i < factors.size(); ++i)
+        new (&without[i]) std::atomic<Element*>(nullptr);
+    
+    Product* prod = arena.create<Product>(nextId(), allocateFactors(factors), without);
+    registerElement(prod);
+    products.emplace(hash, prod);
     return prod;
 }
 
-Heyting::Element* Heyting::coproduct(std::set<Element*> factors) {
+// Copies the factors into the arena, in their order
+template<class C>
+Span<Heyting::Element*> Heyting::allocateFactors(const C& factors) {
+    auto first = (Element**) arena.allocate(factors.size() * sizeof(Element*), alignof(Element*));
+    std::copy(factors.begin(), factors.end(), first);
+    return Span<Element*>(first, factors.size());
+}
+
+Heyting::Element* Heyting::coproduct(std::set<Element*> factors, bool create) {
+    Lock lock(*this, true);
+    
     // If any of the factors is True, we can just return True
     if(std::find(factors.begin(), factors.end(), True) != factors.end())
         return True;
@@ -87,7 +209,7 @@ Heyting::Element* Heyting::coproduct(std::set<Element*> factors) {
     std::set<Element*> new_factors;
     for(auto f : factors) {
         if(f->type == Element::COPRODUCT) {
-            auto other = ((Coproduct*) f)->factors;
+            auto& other = ((Coproduct*) f)->factors;
             new_factors.insert(other.begin(), other.end());
         }
         else {
@@ -95,23 +217,78 @@ Heyting::Element* Heyting::coproduct(std::set<Element*> factors) {
         }
     }
     
+    return internCoproduct(new_factors, create);
+}
+
+// Looks up (or creates) the coproduct of factors that are sorted already, and that are no coproducts, True or False
+template<class C>
+Heyting::Element* Heyting::internCoproduct(const C& factors, bool create) {
     // If a coproduct with these factors already exists, return it
-    for(auto x : elements) {
-        if(x->type != Element::COPRODUCT)
-            continue;
-        
-        Coproduct* coprod = (Coproduct*) x;
-        if(new_factors == coprod->factors)
-            return coprod;
+    size_t hash = hash_set{}(factors);
+    auto range = coproducts.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it) {
+        if(it->second->factors.equals(factors))
+            return it->second;
     }
     
     // Finally, create the actual coproduct, and return it
-    Coproduct* coprod = new Heyting::Coproduct(new_factors);
-    elements.push_back(coprod);
+    if(!create)
+        return nullptr;
+    Coproduct* coprod = arena.create<Coproduct>(nextId(), allocateFactors(factors));
+    registerElement(coprod);
+    coproducts.emplace(hash, coprod);
     return coprod;
 }
 
-Heyting::Element* Heyting::exponential(Heyting::Element* b, Heyting::Element* e) {
+Heyting::Element* Heyting::product(std::vector<Element*>& factors, bool create) {
+    Lock lock(*this, true);
+    if(auto x = normalize(factors, Element::PRODUCT, True, False))
+        return x;
+    return internProduct(factors, create);
+}
+
+Heyting::Element* Heyting::coproduct(std::vector<Element*>& factors, bool create) {
+    Lock lock(*this, true);
+    if(auto x = normalize(factors, Element::COPRODUCT, False, True))
+        return x;
+    return internCoproduct(factors, create);
+}
+
+// Does for a vector of factors what product and coproduct do for a set: drops the unit, replaces the factors of the
+// given kind with their own factors, and sorts them as a std::set would. Returns the result if that is decided
+// already (the absorbing element, the unit, or a single factor), and nullptr if the factors are left to intern
+Heyting::Element* Heyting::normalize(std::vector<Element*>& factors, Element::Type type, Element* unit, Element* absorbing) {
+    if(std::find(factors.begin(), factors.end(), absorbing) != factors.end())
+        return absorbing;
+    
+    factors.erase(std::remove(factors.begin(), factors.end(), unit), factors.end());
+    std::sort(factors.begin(), factors.end(), std::less<Element*>());
+    factors.erase(std::unique(factors.begin(), factors.end()), factors.end());
+    if(factors.empty())
+        return unit;
+    if(factors.size() == 1)
+        return factors.front();
+    
+    // Nested factors are rare, so only then the factors are put together again
+    auto nested = [type](Element* f) { return f->type == type; };
+    if(std::any_of(factors.begin(), factors.end(), nested)) {
+        size_t n = factors.size();
+        for(size_t i = 0;i < n; ++i) {
+            if(!nested(factors[i]))
+                continue;
+            auto& inner = (type == Element::PRODUCT) ? ((Product*) factors[i])->factors : ((Coproduct*) factors[i])->factors;
+            factors.insert(factors.end(), inner.begin(), inner.end());
+        }
+        factors.erase(std::remove_if(factors.begin(), factors.end(), nested), factors.end());
+        std::sort(factors.begin(), factors.end(), std::less<Element*>());
+        factors.erase(std::unique(factors.begin(), factors.end()), factors.end());
+    }
+    return nullptr;
+}
+
+Heyting::Element* Heyting::exponential(Heyting::Element* b, Heyting::Element* e, bool create) {
+    Lock lock(*this, true);
+    
     // If the base is True, simply return True
     if(b == True)
         return True;
@@ -128,70 +305,115 @@ Heyting::Element* Heyting::exponential(Heyting::Element* b, Heyting::Element* e)
     if(b->type == Element::EXPONENTIAL) {
         auto exp = (Exponential*) b;
         b = exp->base;
-        e = product({ e, exp->exponent });
+        e = product({ e, exp->exponent }, create);
+        if(e == nullptr)
+            return nullptr;
     }
     
     // If an exponential with same base and exponent is already constructed before, return it
-    for(auto x : elements) {
-        if(x->type != Element::EXPONENTIAL)
-            continue;
-        
-        Exponential* exp = (Exponential*) x;
-        if(b == exp->base && e == exp->exponent)
-            return exp;
-    }
+    auto pair = std::pair<Id, Id>(b->id, e->id);
+    auto pos = exponentials.find(pair);
+    if(pos != exponentials.end())
+        return pos->second;
     
     // Finally, create the actual exponential, and return it
-    Exponential* exp = new Heyting::Exponential(b, e);
-    elements.push_back(exp);
+    if(!create)
+        return nullptr;
+    Exponential* exp = arena.create<Exponential>(nextId(), b, e);
+    registerElement(exp);
+    exponentials.emplace(pair, exp);
     return exp;
 }
 
-Heyting::Element::Element() : type(ELEMENT) {
+Heyting::Element::Element(Id i, uint64_t f) : type(ELEMENT), id(i), fingerprint(f), depth(0), size(1), created(0), trimmed(0) {
 }
 
-Heyting::Element::Element(Type t) : type(t) {
+Heyting::Element::Element(Type t, Id i, uint64_t f, uint32_t d, uint64_t n) : type(t), id(i), fingerprint(f), depth(d), size(n), created(0), trimmed(0) {
 }
 
-void Heyting::Element::addArrowFrom(Heyting::Element* x) {
-//    if(std::find(arrowsFrom.begin(), arrowsFrom.end(), x) == arrowsFrom.end())
-    if(arrowsFrom.find(x) == arrowsFrom.end())
-        arrowsFrom.insert(x);
+bool Heyting::Element::addArrowFrom(Heyting::Element* x) {
+    // Duplicates are ignored by the adjacency itself
+    return arrowsFrom.insert(x);
 }
 
-void Heyting::Element::addArrowTo(Heyting::Element* x) {
-//    if(std::find(arrowsTo.begin(), arrowsTo.end(), elem) == arrowsTo.end())
-    if(arrowsTo.find(x) == arrowsTo.end())
-        arrowsTo.insert(x);
+bool Heyting::Element::addArrowTo(Heyting::Element* x) {
+    return arrowsTo.insert(x);
 }
 
-Heyting::Product::Product(std::set<Heyting::Element*> f) : Element(PRODUCT), factors(f) {
+Heyting::Product::Product(Id i, Span<Heyting::Element*> f, std::atomic<Heyting::Element*>* w) : Element(PRODUCT, i, fingerprintOf(PRODUCT, f), depthOf(f), sizeOf(f)), factors(f), without(w) {
     for(auto x : factors) {
         addArrowTo(x);
         x->addArrowFrom(this);
     }
 }
 
-Heyting::Coproduct::Coproduct(std::set<Heyting::Element*> f) : Element(COPRODUCT), factors(f) {
+Heyting::Coproduct::Coproduct(Id i, Span<Heyting::Element*> f) : Element(COPRODUCT, i, fingerprintOf(COPRODUCT, f), depthOf(f), sizeOf(f)), factors(f) {
     for(auto x : factors) {
         addArrowFrom(x);
         x->addArrowTo(this);
     }
 }
 
-Heyting::Exponential::Exponential(Element* b, Element* e) : Element(EXPONENTIAL), base(b), exponent(e) {
+Heyting::Exponential::Exponential(Id i, Element* b, Element* e) : Element(EXPONENTIAL, i,
+    mix(mix(b->fingerprint) ^ (mix(e->fingerprint) * 3) ^ ((uint64_t) EXPONENTIAL << 56)),
+    std::max(b->depth, e->depth) + 1, b->size + e->size + 1), base(b), exponent(e) {
 }
 
 Heyting::Element* Heyting::negate(Heyting::Element* x) {
     return exponential(False, x);
 }
 
+Heyting::Element* Heyting::productWithout(Heyting::Product* x, size_t i) {
+    auto cached = x->without[i].load(std::memory_order_acquire);
+    if(cached != nullptr)
+        return cached;
+    
+    Lock lock(*this, true);
+    auto& factors = x->factors;
+    if(factors.size() == 2) {
+        cached = factors[1 - i];
+    }
+    else {
+        // The other factors are still sorted and flat, so they can be looked up without normalizing them again
+        std::vector<Element*> rest;
+        rest.reserve(factors.size() - 1);
+        rest.insert(rest.end(), factors.begin(), factors.begin() + i);
+        rest.insert(rest.end(), factors.begin() + i + 1, factors.end());
+        cached = internProduct(rest, true);
+    }
+    
+    // A child context has to forget the entry again when it is dropped, as the product may be one of its elements
+    if(!frames.empty())
+        filled.push_back(&x->without[i]);
+    x->without[i].store(cached, std::memory_order_release);
+    return cached;
+}
+
 void Heyting::putArrow(Heyting::Element* x, Heyting::Element* y) {
-    x->addArrowTo(y);
-    y->addArrowFrom(x);
+    Lock lock(*this, true);
+    if(loading) {
+        pending.emplace_back(x, y);
+        return;
+    }
+    
+    bool to = x->addArrowTo(y);
+    bool from = y->addArrowFrom(x);
+    if(!to && !from)
+        return;
+    
+    if(logging)
+        log(x, y, to, from);
+    else
+        ++offset;
+    
+    ++currentVersion;
+    if(indexed)
+        reachability.addEdge(x->id, y->id);
 }
 
-bool Heyting::isArrowHelper(std::unordered_set<Heyting::Element*>& marked, Heyting::Element* x, Heyting::Element* y) {
+bool Heyting::isArrow(Heyting::Element* x, Heyting::Element* y) {
+    Lock lock(*this, false);
+    
     // Identity arrows
     if(x == y)
         return true;
@@ -200,96 +422,448 @@ bool Heyting::isArrowHelper(std::unordered_set<Heyting::Element*>& marked, Heyti
     if(x == False || y == True)
         return true;
     
-    // If x is isomorphic to False, or y is isomorphic to True, there is also an arrow
-    if(std::find(x->arrowsTo.begin(), x->arrowsTo.end(), False) != x->arrowsTo.end() ||
-       std::find(y->arrowsFrom.begin(), y->arrowsFrom.end(), True) != y->arrowsFrom.end())
+    // If x is isomorphic to False, there is also an arrow
+    if(x->arrowsTo.contains(False))
         return true;
+    
+    // Use the reachability index if available (this gives exactly the same answers as the search below)
+    if(indexed)
+        return reachability.reaches(x->id, y->id) || reachability.reaches(True->id, y->id);
+    
+    // Start a new search: elements are marked as visited by setting their mark to the current epoch
+    // (the scratch space is kept per thread, so that searches can run concurrently)
+    static thread_local std::vector<uint32_t> marks;
+    static thread_local uint32_t epoch = 0;
+    static thread_local std::vector<Element*> frontier;
+    if(marks.size() < elements.size())
+        marks.resize(elements.size(), 0);
+    if(++epoch == 0) {
+        std::fill(marks.begin(), marks.end(), 0);
+        epoch = 1;
+    }
+    
+    // Walk backwards from y, until either x or True is found
+    frontier.clear();
+    frontier.push_back(y);
+    marks[y->id] = epoch;
+    size_t head = 0;
+    while(head < frontier.size()) {
+        Element* e;
+        if(searchOrder == BREADTH_FIRST) {
+            e = frontier[head++];
+        }
+        else {
+            e = frontier.back();
+            frontier.pop_back();
+        }
         
-    // Otherwise, try to find a connection
-    for(auto e : y->arrowsFrom) {
-        if(e == x)
+        // If e is isomorphic to True, there is an arrow
+        if(e->arrowsFrom.contains(True))
             return true;
         
-        if(marked.find(e) == marked.end()) {
-            marked.insert(e);
-            if(isArrowHelper(marked, x, e))
+        for(auto z : e->arrowsFrom) {
+            if(z == x)
                 return true;
+            
+            if(marks[z->id] != epoch) {
+                marks[z->id] = epoch;
+                frontier.push_back(z);
+            }
         }
     }
     return false;
 }
 
-bool Heyting::isArrow(Heyting::Element* x, Heyting::Element* y) {
-    std::unordered_set<Heyting::Element*> marked;
-    return isArrowHelper(marked, x, y);
+void Heyting::setSearchOrder(SearchOrder order) {
+    searchOrder = order;
+}
+
+void Heyting::setConcurrent(bool flag) {
+    if(flag)
+        ++concurrent;
+    else
+        --concurrent;
+}
+
+Heyting::Element* Heyting::arrowFrom(Heyting::Element* y, size_t i) {
+    Lock lock(*this, false);
+    return i < y->arrowsFrom.size() ? y->arrowsFrom[i] : nullptr;
+}
+
+Heyting::Element* Heyting::arrowTo(Heyting::Element* x, size_t i) {
+    Lock lock(*this, false);
+    return i < x->arrowsTo.size() ? x->arrowsTo[i] : nullptr;
+}
+
+Heyting::Element* Heyting::productOfTargets(Heyting::Element* x) {
+    Lock lock(*this, true);
+    return product(std::set<Element*>(x->arrowsTo.begin(), x->arrowsTo.end()));
 }
 
 void Heyting::clearArrows() {
-    // Clear all arrows
+    Lock lock(*this, true);
+    
+    // Clear all arrows (except for the arrows stored at True and False themselves)
     for(auto x : elements) {
+        if(x == True || x == False)
+            continue;
+        
         x->arrowsFrom.clear();
         x->arrowsTo.clear();
     }
+    
+    ++currentVersion;
+    ++currentGeneration;
+    
+    // The undo log cannot go back past this point
+    offset += changes.size();
+    changes.clear();
+    ++clears;
+    
+    // Rebuild the reachability index from the remaining arrows
+    if(indexed)
+        indexReachability(true);
 }
 
+Heyting::Snapshot Heyting::snapshot() {
+    Lock lock(*this, true);
+    logging = true;
+    ++snapshots;
+    return Snapshot { offset + changes.size(), clears, changes.empty() ? 0 : changes.back().serial };
+}
 
+// Removes all arrows added since the snapshot (elements created since then remain, with their structural arrows)
+// This fails if the arrows have been cleared since, if arrows have been added after the snapshot was released, or if
+// the log has been rolled back further since it was taken (the entry before it is then gone, or has been replaced)
+bool Heyting::rollback(const Snapshot& s) {
+    Lock lock(*this, true);
+    if(s.clears != clears || s.position < offset || s.position > offset + changes.size())
+        return false;
+    if(s.position > offset && changes[s.position - offset - 1].serial != s.serial)
+        return false;
+    
+    undo(s.position);
+    invalidate();
+    return true;
+}
 
+// Every snapshot is released once (it cannot be rolled back to afterwards), so that the log can be dropped
+void Heyting::release(const Snapshot&) {
+    Lock lock(*this, true);
+    if(snapshots > 0)
+        --snapshots;
+    trim();
+}
 
+void Heyting::push() {
+    Lock lock(*this, true);
+    logging = true;
+    frames.push_back(Frame { offset + changes.size(), elements.size(), arena.mark(), clears, filled.size() });
+}
 
+// Drops the innermost child context, in time proportional to what was added to it
+bool Heyting::pop() {
+    Lock lock(*this, true);
+    if(frames.empty())
+        return false;
+    
+    // First the arrows, so that only the structural arrows of the new elements remain
+    // (if the arrows have been cleared inside the context, the log is gone, and there is nothing left to undo)
+    Frame frame = frames.back();
+    frames.pop_back();
+    bool cleared = (frame.clears != clears);
+    if(!cleared)
+        undo(frame.position);
+    
+    drop(frame, cleared);
+    invalidate();
+    trim();
+    return true;
+}
 
+size_t Heyting::reclaim() {
+    Lock lock(*this, true);
+    if(frames.empty())
+        return 0;
+    
+    // If the arrows were cleared inside the context, nothing from before it is left to keep
+    Frame frame = frames.back();
+    size_t n = elements.size() - frame.elements;
+    if(frame.clears != clears) {
+        pop();
+        return n;
+    }
+    frames.pop_back();
+    ++reclaimed;
+    
+    // Only the entries of the log that involve the new elements go (destroying the elements takes their arrows away),
+    // the arrows between older elements stay where they are, in the log as well as in the adjacencies
+    auto end = std::remove_if(changes.begin() + (frame.position - offset), changes.end(), [&frame](const Change& change) {
+        return change.x->id >= frame.elements || change.y->id >= frame.elements;
+    });
+    changes.erase(end, changes.end());
+    
+    // The older elements with arrows from the new ones lose them
+    for(size_t i = frame.elements;i < elements.size(); ++i)
+        for(auto y : elements[i]->arrowsTo)
+            if(y->id < frame.elements)
+                y->trimmed = reclaimed;
+    drop(frame, false);
+    ++currentVersion;
+    
+    // The index only has to forget the paths through the new elements
+    if(indexed) {
+        auto stale = reachability.stale(frame.elements);
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        for(auto x : stale)
+            for(auto y : elements[x]->arrowsTo)
+                edges.emplace_back(x, y->id);
+        reachability.shrink(frame.elements, stale, edges);
+    }
+    trim();
+    return n;
+}
 
+void Heyting::log(Heyting::Element* x, Heyting::Element* y, bool to, bool from) {
+    changes.push_back(Change { x, y, to, from, ++serials });
+}
 
+void Heyting::undo(size_t position) {
+    while(offset + changes.size() > position) {
+        auto& change = changes.back();
+        if(change.to)
+            change.x->arrowsTo.erase(change.y);
+        if(change.from)
+            change.y->arrowsFrom.erase(change.x);
+        changes.pop_back();
+    }
+}
 
-
-#include <iostream>
-
-std::string Heyting::Element::to_string() {
-    return name;
+// Once no snapshot and no child context is live, nothing can be undone any more: the log stops
+void Heyting::trim() {
+    if(snapshots > 0 || !frames.empty())
+        return;
+    logging = false;
+    offset += changes.size();
+    changes.clear();
 }
 
-std::string Heyting::Product::to_string() {
-    std::string s;
-    for(auto f : factors) {
-        std::string str_f = f->to_string();
-        if(str_f.find(" ") != std::string::npos)
-            s += "(" + str_f + ")";
-        else
-            s += str_f;
-        s +=  + " ^ ";
+// Drops the elements created in a child context (after the arrows in its log are gone)
+void Heyting::drop(const Heyting::Frame& frame, bool cleared) {
+    // First the cached products, which may refer to the new elements
+    while(filled.size() > frame.filled) {
+        filled.back()->store(nullptr, std::memory_order_relaxed);
+        filled.pop_back();
     }
-    s.pop_back();
-    s.pop_back();
-    s.pop_back();
-    return s;
+    
+    // Then the new elements, newest first, so that their entries are at the end of the adjacencies they are in
+    while(elements.size() > frame.elements) {
+        destroy(elements.back(), cleared);
+        elements.pop_back();
+    }
+    population.store(elements.size(), std::memory_order_relaxed);
+    arena.release(frame.mark);
 }
 
-std::string Heyting::Coproduct::to_string() {
-    std::string s;
-    for(auto f : factors) {
-        std::string str_f = f->to_string();
-        if(str_f.find(" ") != std::string::npos)
-            s += "(" + str_f + ")";
-        else
-            s += str_f;
-        s +=  + " v ";
+// Removes an element from the interning tables and from the adjacencies of the elements it has arrows with
+void Heyting::destroy(Heyting::Element* x, bool cleared) {
+    for(auto y : x->arrowsTo)
+        y->arrowsFrom.erase(x);
+    for(auto y : x->arrowsFrom)
+        y->arrowsTo.erase(x);
+    
+    // The arrows stored at True and False themselves outlive clearArrows, so these may still refer to x
+    if(cleared) {
+        True->arrowsFrom.erase(x);
+        True->arrowsTo.erase(x);
+        False->arrowsFrom.erase(x);
+        False->arrowsTo.erase(x);
+    }
+    
+    switch(x->type) {
+        case Element::ELEMENT:
+            names.erase(x->id);
+            x->~Element();
+            break;
+            
+        case Element::PRODUCT: {
+            auto prod = (Product*) x;
+            auto range = products.equal_range(hash_set{}(prod->factors));
+            for(auto it = range.first; it != range.second; ++it) {
+                if(it->second == prod) {
+                    products.erase(it);
+                    break;
+                }
+            }
+            prod->~Product();
+            break;
+        }
+            
+        case Element::COPRODUCT: {
+            auto coprod = (Coproduct*) x;
+            auto range = coproducts.equal_range(hash_set{}(coprod->factors));
+            for(auto it = range.first; it != range.second; ++it) {
+                if(it->second == coprod) {
+                    coproducts.erase(it);
+                    break;
+                }
+            }
+            coprod->~Coproduct();
+            break;
+        }
+            
+        case Element::EXPONENTIAL: {
+            auto exp = (Exponential*) x;
+            exponentials.erase(std::pair<Id, Id>(exp->base->id, exp->exponent->id));
+            exp->~Exponential();
+            break;
+        }
     }
-    s.pop_back();
-    s.pop_back();
-    s.pop_back();
-    return s;
 }
 
-std::string Heyting::Exponential::to_string() {
-    std::string str_b = base->to_string();
-    std::string str_e = exponent->to_string();
+// Arrows are gone, so earlier conclusions (such as the memo of a prover) no longer hold
+void Heyting::invalidate() {
+    ++currentVersion;
+    ++currentGeneration;
     
-    if(str_b.find(" ") != std::string::npos)
-        str_b = "(" + str_b + ")";
+    // The index cannot forget paths, so it is built again
+    if(indexed)
+        indexReachability(true);
+}
+
+Heyting::Context::Context(Heyting& h) : heyting(h) {
+    heyting.push();
+}
+
+Heyting::Context::~Context() {
+    heyting.pop();
+}
+
+void Heyting::beginBulk() {
+    Lock lock(*this, true);
+    loading = true;
+}
+
+void Heyting::endBulk(bool index) {
+    Lock lock(*this, true);
+    if(!loading)
+        return;
+    loading = false;
     
-    if(str_e.find(" ") != std::string::npos)
-        str_e = "(" + str_e + ")";
+    // The same as putArrow, but for the reachability index, which is built once at the end
+    bool added = false;
+    for(auto& arrow : pending) {
+        bool to = arrow.first->addArrowTo(arrow.second);
+        bool from = arrow.second->addArrowFrom(arrow.first);
+        if(!to && !from)
+            continue;
+        if(logging)
+            log(arrow.first, arrow.second, to, from);
+        else
+            ++offset;
+        added = true;
+    }
+    std::vector<std::pair<Element*, Element*>>().swap(pending);
+    if(added)
+        ++currentVersion;
     
-    return str_e + " => " + str_b;
+    if(index || indexed) {
+        indexed = true;
+        rebuildIndex();
+    }
+}
+
+Heyting::Bulk::Bulk(Heyting& h) : heyting(h) {
+    heyting.beginBulk();
+}
+
+Heyting::Bulk::~Bulk() {
+    heyting.endBulk();
 }
 
+void Heyting::indexReachability(bool flag) {
+    Lock lock(*this, true);
+    indexed = flag;
+    reachability.clear();
+    if(indexed)
+        rebuildIndex();
+}
+
+// Builds the index from scratch, from all arrows at once
+void Heyting::rebuildIndex() {
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for(auto y : elements)
+        for(auto x : y->arrowsFrom)
+            edges.emplace_back(x->id, y->id);
+    reachability.build(elements.size(), edges);
+}
+
+
 
+
+
+
+
+
+
+
+
+std::string Heyting::name(Heyting::Element* x) {
+    Lock lock(*this, false);
+    auto pos = names.find(x->id);
+    return pos != names.end() ? pos->second : std::string();
+}
+
+std::string Heyting::to_string(Heyting::Element* x) {
+    Lock lock(*this, false);
+    std::string s;
+    s.reserve(x->size * 4);
+    write(s, x);
+    return s;
+}
+
+// Appends the formula to the string, putting parentheses around every subformula that contains a space
+void Heyting::write(std::string& s, Heyting::Element* x) {
+    auto subformula = [this, &s](Element* f) {
+        bool parenthesize = (f->type != Element::ELEMENT);
+        if(!parenthesize) {
+            auto pos = names.find(f->id);
+            parenthesize = (pos != names.end()) && (pos->second.find(' ') != std::string::npos);
+        }
+        if(parenthesize)
+            s += '(';
+        write(s, f);
+        if(parenthesize)
+            s += ')';
+    };
+    
+    switch(x->type) {
+        case Element::PRODUCT:
+        case Element::COPRODUCT: {
+            auto& factors = (x->type == Element::PRODUCT) ? ((Product*) x)->factors : ((Coproduct*) x)->factors;
+            const char* separator = (x->type == Element::PRODUCT) ? " ^ " : " v ";
+            bool first = true;
+            for(auto f : factors) {
+                if(!first)
+                    s += separator;
+                subformula(f);
+                first = false;
+            }
+            break;
+        }
+            
+        case Element::EXPONENTIAL: {
+            auto exp = (Exponential*) x;
+            subformula(exp->exponent);
+            s += " => ";
+            subformula(exp->base);
+            break;
+        }
+            
+        default: {
+            auto pos = names.find(x->id);
+            if(pos != names.end())
+                s += pos->second;
+        }
+    }
+}
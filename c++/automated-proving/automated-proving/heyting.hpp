@@ -4,79 +4,265 @@
 #include <vector>
 #include <set>
 #include <string>
-#include <unordered_set>
+#include <cstdint>
+#include <unordered_map>
 #include <algorithm>
+#include <atomic>
+#include <shared_mutex>
+#include "hashpair.hpp"
+#include "arena.hpp"
+#include "reachability.hpp"
+#include "adjacency.hpp"
+#include "span.hpp"
 
 class Heyting {
 
+    friend class Store;
+    friend class Classical;
+    friend class Countermodels;
+    
 public:
     
+    typedef uint32_t Id;
+    
+    enum SearchOrder { DEPTH_FIRST, BREADTH_FIRST };
+    
     struct Element {
         enum Type { ELEMENT, PRODUCT, COPRODUCT, EXPONENTIAL };
         const Type type;
-        std::set<Element*> arrowsFrom, arrowsTo;
-        Element();
-        void addArrowFrom(Element*);
-        void addArrowTo(Element*);
+        const Id id;
+        
+        // Computed once at construction: the fingerprint only depends on the structure of the formula
+        // (and the names of the plain elements in it), so it is the same across runs
+        const uint64_t fingerprint;
+        const uint32_t depth;   // Nesting depth of the formula, 0 for plain elements
+        const uint64_t size;    // Number of symbols in the formula, counting shared subformulas every time they occur
+        
+        Adjacency<Element*> arrowsFrom, arrowsTo;
+        
+        // Number of child contexts reclaimed before the element was created, and before arrows to it were last taken
+        // away by one, so that whoever looked at the elements before a reclaim can tell which ones changed since
+        uint64_t created, trimmed;
         
-        std::string name;
-        virtual std::string to_string();
+        Element(Id, uint64_t);
+        bool addArrowFrom(Element*);
+        bool addArrowTo(Element*);
         
     protected:
-        Element(Type);
+        Element(Type, Id, uint64_t, uint32_t, uint64_t);
         
     };
     
+    // The factors are sorted (by address, as in a std::set) and stored in the arena
     struct Product : Element {
-        const std::set<Element*> factors;
-        Product(std::set<Element*>);
+        const Span<Element*> factors;
         
-        std::string to_string();
+        // For every factor, the product of all other factors once it has been asked for (see productWithout)
+        std::atomic<Element*>* const without;
+        
+        Product(Id, Span<Element*>, std::atomic<Element*>*);
     };
     
     struct Coproduct : Element {
-        const std::set<Element*> factors;
-        Coproduct(std::set<Element*>);
-        
-        std::string to_string();
+        const Span<Element*> factors;
+        Coproduct(Id, Span<Element*>);
     };
     
     struct Exponential : Element {
         Element* const base;
         Element* const exponent;
-        Exponential(Element*, Element*);
-        
-        std::string to_string();
+        Exponential(Id, Element*, Element*);
     };
     
 private:
     
-    Element T, F;
-    
+    // All elements are allocated in the arena, and are indexed by their id
+    Arena arena;
     std::vector<Element*> elements;
+    std::atomic<size_t> population;     // Size of elements, which other threads may read while it changes
+    std::unordered_map<Id, std::string> names;
+    
+    // Hash indices used for interning products, coproducts and exponentials
+    std::unordered_multimap<size_t, Product*> products;
+    std::unordered_multimap<size_t, Coproduct*> coproducts;
+    std::unordered_map<std::pair<Id, Id>, Exponential*, hash_pair> exponentials;
     
-    bool isArrowHelper(std::unordered_set<Heyting::Element*>&, Heyting::Element*, Heyting::Element*);
+    // Optional index of the transitive closure of the arrows, used by isArrow
+    bool indexed;
+    Reachability reachability;
+    
+    // While bulk loading, the arrows collected by putArrow (in order), which endBulk adds
+    bool loading;
+    std::vector<std::pair<Element*, Element*>> pending;
+    
+    Id nextId();
+    void registerElement(Element*);
+    
+    void write(std::string&, Element*);
+    
+    Element* normalize(std::vector<Element*>&, Element::Type, Element*, Element*);
+    template<class C>
+    Element* internProduct(const C&, bool);
+    template<class C>
+    Element* internCoproduct(const C&, bool);
+    template<class C>
+    Span<Element*> allocateFactors(const C&);
+    
+    void log(Element*, Element*, bool, bool);
+    void undo(size_t);
+    void trim();
+    void destroy(Element*, bool);
+    void invalidate();
+    void rebuildIndex();
+    
+    // Counters that change whenever arrows are added (version) or cleared (both), and whenever a child context
+    // is reclaimed (along with the version, see Element::created)
+    std::atomic<uint64_t> currentVersion;
+    std::atomic<uint64_t> currentGeneration;
+    std::atomic<uint64_t> reclaimed;
+    
+    SearchOrder searchOrder;
+    
+    // Undo log of the arrows added by putArrow while a snapshot or a child context is live (with the sides that
+    // were actually new). Positions in the log also count the arrows before it (offset): the ones added while nothing
+    // was logged, and the entries dropped from its front. Every entry gets a serial number, so that a snapshot can
+    // tell whether the log before it was undone since
+    struct Change {
+        Element* x;
+        Element* y;
+        bool to, from;
+        uint64_t serial;
+    };
+    bool logging;
+    std::vector<Change> changes;
+    size_t offset;
+    uint64_t serials;
+    size_t snapshots;
+    uint64_t clears;
+    
+    // The open child contexts, innermost last: where the log, the elements and the arena were when each was opened
+    struct Frame {
+        size_t position;
+        size_t elements;
+        Arena::Mark mark;
+        uint64_t clears;
+        size_t filled;
+    };
+    std::vector<Frame> frames;
+    void drop(const Frame&, bool);
+    
+    // Entries of the productWithout caches filled while a child context is open (they may refer to its elements)
+    std::vector<std::atomic<Element*>*> filled;
+    
+    // When the algebra is shared between threads, all access goes through a readers-writer lock
+    // (the number of users that share it, such as thread pools and services: it is locked while there are any)
+    std::atomic<int> concurrent;
+    std::shared_timed_mutex mutex;
+    
+    class Lock {
+        Heyting& heyting;
+        Heyting* previous;
+        bool locked, exclusive;
+    public:
+        Lock(Heyting&, bool);
+        ~Lock();
+    };
     
 public:
     
     Element* const True;
     Element* const False;
     
+    // A state of the arrows to return to: taking one is O(1), rolling back costs the arrows added since
+    // (it holds on to the undo log until it is released)
+    struct Snapshot {
+        size_t position;
+        uint64_t clears;
+        uint64_t serial;    // Of the last entry of the log before it, 0 for none
+    };
+    
     Heyting();
     ~Heyting();
     
+    size_t size() { return population.load(std::memory_order_relaxed); }
+    Element* element(Id id) { return elements[id]; }
+    
     Element* createElement();
     Element* createElement(std::string);
-    Element* product(std::set<Element*>);
-    Element* coproduct(std::set<Element*>);
-    Element* exponential(Element*, Element*);
+    // Without create, these return nullptr instead of constructing a new element
+    Element* product(std::set<Element*>, bool = true);
+    Element* coproduct(std::set<Element*>, bool = true);
+    // The same for factors in a vector the caller reuses, in any order and with repetitions
+    // (they are sorted and deduplicated in place, so the vector is left changed)
+    Element* product(std::vector<Element*>&, bool = true);
+    Element* coproduct(std::vector<Element*>&, bool = true);
+    Element* exponential(Element*, Element*, bool = true);
     
     Element* negate(Element*);
     
+    // The product of all factors of a product except the i-th one, cached in the product after the first time
+    Element* productWithout(Product*, size_t);
+    
     void putArrow(Element*, Element*);
     bool isArrow(Element*, Element*);
     void clearArrows();
     
+    Snapshot snapshot();
+    bool rollback(const Snapshot&);
+    void release(const Snapshot&);
+    
+    // Child contexts: everything added after push (elements included) is dropped again by the matching pop
+    void push();
+    bool pop();
+    
+    // Drops the innermost child context like pop, but keeps the arrows added in it between elements from before it,
+    // and returns the number of elements that were reclaimed. What held between those elements still holds,
+    // so unlike pop this does not start a new generation
+    size_t reclaim();
+    size_t contexts() { return frames.size(); }
+    
+    // Opens a child context for as long as it is in scope
+    class Context {
+        Heyting& heyting;
+    public:
+        Context(Heyting&);
+        ~Context();
+    };
+    
+    // Bulk loading: until endBulk, putArrow only collects the arrows, and the reachability index is left alone.
+    // endBulk adds them all, and then (unless told otherwise) indexes reachability in a single pass, so that
+    // isArrow answers from the index. In between, only elements may be created and arrows put (other queries
+    // do not see the collected arrows yet)
+    void beginBulk();
+    void endBulk(bool = true);
+    
+    // Loads in bulk for as long as it is in scope
+    class Bulk {
+        Heyting& heyting;
+    public:
+        Bulk(Heyting&);
+        ~Bulk();
+    };
+    
+    Element* arrowFrom(Element*, size_t);
+    Element* arrowTo(Element*, size_t);
+    Element* productOfTargets(Element*);
+    
+    void indexReachability(bool);
+    void setSearchOrder(SearchOrder);
+    
+    // Every user that shares the algebra between threads calls setConcurrent(true) before its threads start,
+    // and setConcurrent(false) once they are done, so that users which overlap do not switch the lock off for each other
+    void setConcurrent(bool);
+    bool isConcurrent() { return concurrent.load() > 0; }
+    
+    uint64_t version() { return currentVersion; }
+    uint64_t generation() { return currentGeneration; }
+    uint64_t reclaims() { return reclaimed; }
+    
+    std::string name(Element*);
+    std::string to_string(Element*);
+    
 };
 
 #endif
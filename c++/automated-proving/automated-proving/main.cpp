@@ -1,9 +1,95 @@
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 #include "tests.hpp"
+#include "mappedfile.hpp"
+#include "parser.hpp"
+
+// Proves all goals in a problem file, printing one line per goal, and returns the number of goals that were not shown
+static size_t solve(const std::string& path, size_t threads, int maxPay, bool refute, bool verbose, bool dump) {
+    MappedFile file(path);
+    Heyting h;
+    Prover prover(h);
+    prover.setVerbose(verbose);
+    prover.setThreads(threads);
+    prover.setRefutation(refute);
+    if(maxPay >= 0)
+        prover.setMaxPay(maxPay);
+    
+    Parser parser(h, file.begin(), file.end());
+    Parser::Problem problem;
+    Prover::Stats stats, total;
+    size_t goals = 0, failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    
+    // The goals of a problem are shown together, in its own context
+    while(parser.next(problem)) {
+        auto results = prover.implications(problem.goals, stats);
+        total += stats;
+        for(size_t i = 0;i < results.size(); ++i) {
+            auto& goal = problem.goals[i];
+            std::cout << path << ":" << problem.lines[i] << ": " << (problem.name.empty() ? "-" : problem.name) << ": ";
+            std::cout << (results[i] ? "proved" : "not proved") << ": (" << h.to_string(goal.first) << ") => (" << h.to_string(goal.second) << ")" << std::endl;
+            if(!results[i])
+                ++failed;
+        }
+        goals += results.size();
+    }
+    
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << path << ": " << (goals - failed) << " / " << goals << " goals proved in " << elapsed << "s" << std::endl;
+    if(dump) {
+        total.dump(std::cerr);
+        std::cerr << std::endl;
+    }
+    return failed;
+}
 
 int main(int argc, const char * argv[]) {
 
-    Tests::run();
+    // Without problem files, run the tests
+    std::vector<std::string> paths;
+    size_t threads = 1;
+    int maxPay = -1;
+    bool refute = false, verbose = false, stats = false;
+    for(int i = 1;i < argc; ++i) {
+        if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = (size_t) std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--max-pay") == 0 && i + 1 < argc)
+            maxPay = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--refute") == 0)
+            refute = true;
+        else if(std::strcmp(argv[i], "--verbose") == 0)
+            verbose = true;
+        else if(std::strcmp(argv[i], "--stats") == 0)
+            stats = true;
+        else if(argv[i][0] == '-') {
+            std::cerr << "usage: " << argv[0] << " [--threads n] [--max-pay n] [--refute] [--verbose] [--stats] [file ...]" << std::endl;
+            return 2;
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+    
+    if(paths.empty()) {
+        Tests::run();
+        return 0;
+    }
+    
+    // The exit status is 1 if some goal was not shown, and 2 if a file could not be read
+    int status = 0;
+    for(auto& path : paths) {
+        try {
+            if(solve(path, threads, maxPay, refute, verbose, stats) > 0 && status == 0)
+                status = 1;
+        }
+        catch(const std::runtime_error& e) {
+            std::cerr << path << ": " << e.what() << std::endl;
+            status = 2;
+        }
+    }
     
-    return 0;
+    return status;
 }
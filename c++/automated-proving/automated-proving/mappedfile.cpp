@@ -0,0 +1,44 @@
+#include "mappedfile.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const std::string& path) : data(nullptr), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+    
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(path + ": " + std::strerror(error));
+    }
+    length = (size_t) st.st_size;
+    
+    // An empty file cannot be mapped, and does not need to be
+    if(length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error(path + ": " + std::strerror(error));
+        }
+        data = (const char*) p;
+        
+        // The file is read front to back
+        madvise(p, length, MADV_SEQUENTIAL);
+    }
+    
+    // The mapping stays valid after closing the file
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if(data != nullptr)
+        munmap((void*) data, length);
+}
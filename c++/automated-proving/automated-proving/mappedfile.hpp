@@ -0,0 +1,28 @@
+#ifndef mappedfile_hpp
+#define mappedfile_hpp
+
+#include <string>
+#include <cstddef>
+
+// A file mapped read-only into memory, for as long as the object lives
+class MappedFile {
+
+    const char* data;
+    size_t length;
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+public:
+    
+    // Throws std::runtime_error if the file cannot be opened or mapped
+    MappedFile(const std::string&);
+    ~MappedFile();
+    
+    const char* begin() const { return data; }
+    const char* end() const { return data + length; }
+    size_t size() const { return length; }
+    
+};
+
+#endif
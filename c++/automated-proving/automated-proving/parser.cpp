@@ -0,0 +1,227 @@
+#include "parser.hpp"
+#include <stdexcept>
+
+static bool isNameCharacter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '\'';
+}
+
+size_t Parser::hash_name::operator()(const Name& name) const noexcept {
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325;
+    for(size_t i = 0;i < name.n; ++i)
+        h = (h ^ (unsigned char) name.s[i]) * 0x100000001b3;
+    return (size_t) h;
+}
+
+Parser::Parser(Heyting& h, const char* begin, const char* e) : heyting(h), p(begin), end(e), line(1), open(false) {
+}
+
+Parser::~Parser() {
+    close();
+}
+
+// Drops the context of the current problem, with the atoms it introduced
+void Parser::close() {
+    if(!open)
+        return;
+    
+    for(auto& name : local)
+        atoms.erase(name);
+    local.clear();
+    heyting.pop();
+    open = false;
+}
+
+void Parser::error(const std::string& message) {
+    throw std::runtime_error("line " + std::to_string(line) + ": " + message);
+}
+
+void Parser::skipSpace() {
+    while(p != end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        ++p;
+}
+
+// Whether the statement on the current line is finished (a comment finishes it as well)
+bool Parser::atEnd() {
+    skipSpace();
+    return p == end || *p == '\n' || *p == '#';
+}
+
+bool Parser::accept(const char* token) {
+    skipSpace();
+    size_t n = std::strlen(token);
+    if((size_t) (end - p) < n || std::memcmp(p, token, n) != 0)
+        return false;
+    p += n;
+    return true;
+}
+
+// Like accept, but only if the token is not the start of a longer name
+bool Parser::acceptWord(const char* token) {
+    skipSpace();
+    size_t n = std::strlen(token);
+    if((size_t) (end - p) < n || std::memcmp(p, token, n) != 0 || (p + n != end && isNameCharacter(p[n])))
+        return false;
+    p += n;
+    return true;
+}
+
+Parser::Name Parser::word() {
+    skipSpace();
+    const char* s = p;
+    while(p != end && isNameCharacter(*p))
+        ++p;
+    return Name { s, (size_t) (p - s) };
+}
+
+// The remainder of the line, without the comment and the surrounding spaces
+std::string Parser::rest() {
+    skipSpace();
+    const char* s = p;
+    while(p != end && *p != '\n' && *p != '#')
+        ++p;
+    const char* e = p;
+    while(e != s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r'))
+        --e;
+    return std::string(s, e);
+}
+
+bool Parser::next(Problem& problem) {
+    close();
+    problem.name.clear();
+    problem.goals.clear();
+    problem.lines.clear();
+    
+    while(p != end) {
+        if(!atEnd()) {
+            const char* start = p;
+            if(acceptWord("problem")) {
+                // The next problem starts here, so this one is complete
+                if(open) {
+                    p = start;
+                    return true;
+                }
+                heyting.push();
+                open = true;
+                problem.name = rest();
+            }
+            else if(acceptWord("assume")) {
+                auto arrow = statement();
+                heyting.putArrow(arrow.first, arrow.second);
+            }
+            else if(acceptWord("prove")) {
+                // A goal outside of any problem starts an unnamed one
+                if(!open) {
+                    heyting.push();
+                    open = true;
+                }
+                problem.goals.push_back(statement());
+                problem.lines.push_back(line);
+            }
+            else {
+                error("expected problem, assume or prove");
+            }
+        }
+        
+        // Skip the comment, and go to the next line
+        if(!atEnd())
+            error("unexpected '" + std::string(1, *p) + "'");
+        while(p != end && *p != '\n')
+            ++p;
+        if(p != end) {
+            ++p;
+            ++line;
+        }
+    }
+    return open;
+}
+
+// The arrow stated by a formula: x => y for an implication at the top, and True => x otherwise
+Prover::Goal Parser::statement() {
+    auto x = disjunction();
+    if(accept("=>") || accept("->") || accept("⇒") || accept("→"))
+        return Prover::Goal(x, formula());
+    return Prover::Goal(heyting.True, x);
+}
+
+Heyting::Element* Parser::formula() {
+    auto x = disjunction();
+    if(accept("=>") || accept("->") || accept("⇒") || accept("→"))
+        return heyting.exponential(formula(), x);
+    return x;
+}
+
+std::vector<Heyting::Element*> Parser::takeFactors() {
+    std::vector<Heyting::Element*> factors;
+    if(!spare.empty()) {
+        factors.swap(spare.back());
+        spare.pop_back();
+    }
+    return factors;
+}
+
+void Parser::giveFactors(std::vector<Heyting::Element*>& factors) {
+    factors.clear();
+    spare.push_back(std::move(factors));
+}
+
+// The factors of a whole chain are collected first, so that only one coproduct is interned for it
+Heyting::Element* Parser::disjunction() {
+    auto x = conjunction();
+    if(!(accept("\\/") || accept("|") || accept("∨") || acceptWord("v")))
+        return x;
+    
+    auto factors = takeFactors();
+    factors.push_back(x);
+    do {
+        factors.push_back(conjunction());
+    } while(accept("\\/") || accept("|") || accept("∨") || acceptWord("v"));
+    x = heyting.coproduct(factors);
+    giveFactors(factors);
+    return x;
+}
+
+Heyting::Element* Parser::conjunction() {
+    auto x = unary();
+    if(!(accept("/\\") || accept("^") || accept("&") || accept("∧")))
+        return x;
+    
+    auto factors = takeFactors();
+    factors.push_back(x);
+    do {
+        factors.push_back(unary());
+    } while(accept("/\\") || accept("^") || accept("&") || accept("∧"));
+    x = heyting.product(factors);
+    giveFactors(factors);
+    return x;
+}
+
+Heyting::Element* Parser::unary() {
+    if(accept("~") || accept("!") || accept("¬"))
+        return heyting.negate(unary());
+    if(acceptWord("true") || accept("⊤"))
+        return heyting.True;
+    if(acceptWord("false") || accept("⊥"))
+        return heyting.False;
+    
+    if(accept("(")) {
+        auto x = formula();
+        if(!accept(")"))
+            error("expected ')'");
+        return x;
+    }
+    
+    auto name = word();
+    if(name.n == 0)
+        error(p == end || *p == '\n' ? "unexpected end of line" : "unexpected '" + std::string(1, *p) + "'");
+    
+    // Atoms are created on first use, in the context of the current problem if there is one
+    auto pos = atoms.find(name);
+    if(pos != atoms.end())
+        return pos->second;
+    auto x = heyting.createElement(std::string(name.s, name.n));
+    atoms.emplace(name, x);
+    if(open)
+        local.push_back(name);
+    return x;
+}
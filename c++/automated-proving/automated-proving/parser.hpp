@@ -0,0 +1,92 @@
+#ifndef parser_hpp
+#define parser_hpp
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+#include "heyting.hpp"
+#include "prover.hpp"
+
+/*
+ * Reads problems in a plain text format, one statement per line ('#' starts a comment):
+ *
+ *   assume p => q          hypothesis, shared by all problems if it comes before the first problem
+ *   problem name           starts a new problem (its hypotheses and atoms are dropped at the next one)
+ *   assume p
+ *   prove q ^ ~r           goal
+ *
+ * Formulas are built from atoms, true, false, ~ (or ¬, !), ^ (or ∧, &, /\), v (or ∨, |, \/) and => (or ⇒, ->, →),
+ * binding in that order, with => associating to the right. A statement "assume x => y" becomes the arrow x => y,
+ * any other formula x the arrow True => x, and likewise for goals.
+ *
+ * The parser goes over the text once and interns every subformula into the Heyting algebra as soon as it is read.
+ * Atom names are looked up in place, so the text has to outlive the parser.
+ */
+class Parser {
+
+public:
+    
+    struct Problem {
+        std::string name;
+        std::vector<Prover::Goal> goals;
+        std::vector<size_t> lines;  // Line of every goal
+    };
+    
+private:
+    
+    // An atom name, pointing into the text
+    struct Name {
+        const char* s;
+        size_t n;
+        bool operator==(const Name& other) const { return n == other.n && std::memcmp(s, other.s, n) == 0; }
+    };
+    
+    struct hash_name {
+        size_t operator()(const Name&) const noexcept;
+    };
+    
+    Heyting& heyting;
+    const char* p;
+    const char* const end;
+    size_t line;
+    
+    // Every problem is read in a child context of the algebra, which holds its hypotheses and atoms
+    bool open;
+    std::unordered_map<Name, Heyting::Element*, hash_name> atoms;
+    std::vector<Name> local;    // Atoms introduced by the current problem
+    
+    // Vectors for the factors of chains of ^ and v, which keep their memory from one chain to the next
+    // (a chain takes one for as long as it is read, as chains nest)
+    std::vector<std::vector<Heyting::Element*>> spare;
+    std::vector<Heyting::Element*> takeFactors();
+    void giveFactors(std::vector<Heyting::Element*>&);
+    
+    void close();
+    [[noreturn]] void error(const std::string&);
+    
+    void skipSpace();
+    bool atEnd();
+    bool accept(const char*);
+    bool acceptWord(const char*);
+    Name word();
+    std::string rest();
+    
+    Prover::Goal statement();
+    Heyting::Element* formula();
+    Heyting::Element* disjunction();
+    Heyting::Element* conjunction();
+    Heyting::Element* unary();
+    
+public:
+    
+    Parser(Heyting&, const char*, const char*);
+    ~Parser();
+    
+    // Reads up to the end of the next problem, and returns false if there is none
+    // Throws std::runtime_error (with the line number) on a syntax error
+    bool next(Problem&);
+    
+};
+
+#endif
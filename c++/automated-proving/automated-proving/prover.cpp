@@ -2,121 +2,837 @@
 #include <functional>
 #include <utility>
 #include <iostream>
+#include <chrono>
+#include <limits>
+#include <algorithm>
 
-bool Prover::implication(Heyting::Element* x, Heyting::Element* y) {
-    // Keep track of which implications are tried to be shown, and with what pay
-    std::unordered_map<std::pair<Heyting::Element*, Heyting::Element*>, int, hash_pair> map;
-    for(int pay = 0;pay < 3; ++pay)
-        if(implicationHelper(x, y, map, pay)) {
-            std::cout << "Showed (" << x->to_string() << ") => (" << y->to_string() << ") with pay " << pay << std::endl;
-            return true;
-        }
+// Parallel branches are organized in groups: cancelling a group cancels all groups nested in it
+struct Group {
+    const Group* const parent;
+    std::atomic<bool> cancelled;
+    
+    Group(const Group* p) : parent(p), cancelled(false) {}
     
-    return false;
+    bool isCancelled() const {
+        for(auto g = this; g != nullptr; g = g->parent)
+            if(g->cancelled)
+                return true;
+        return false;
+    }
+};
+
+// The group of the branch running on the current thread, and its depth in the search
+static thread_local const Group* currentGroup = nullptr;
+static thread_local int currentDepth = 0;
+
+// The statistics the current thread adds to, if any
+static thread_local Prover::Stats* currentStats = nullptr;
+
+// Number of subgoals the current thread has cut off for lack of pay (or failed on an attempt that was), so that
+// a failed attempt can tell whether anything below it was cut off
+static thread_local uint64_t cutoffs = 0;
+
+// Smallest depth of an open attempt that the search below the current node ran into: such a cycle only
+// says something about the nodes at or above that depth
+static thread_local int cycle = std::numeric_limits<int>::max();
+
+static inline Prover::Stats* stats() {
+    return PROVER_STATS ? currentStats : nullptr;
 }
 
-bool Prover::implicationHelper(Heyting::Element* x, Heyting::Element* y, std::unordered_map<std::pair<Heyting::Element*, Heyting::Element*>, int, hash_pair>& map, int pay) {
-    // Require enough pay
-    if(pay < 0)
-        return false;
+static inline uint64_t nanoseconds(std::chrono::steady_clock::time_point start) {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Sets the state of the search for a task on the current thread, and restores the previous state afterwards
+class Scope {
+    const Group* const savedGroup;
+    const int savedDepth;
+    Prover::Stats* const savedStats;
+public:
+    Scope(const Group* group, int depth, Prover::Stats* s) : savedGroup(currentGroup), savedDepth(currentDepth), savedStats(currentStats) {
+        currentGroup = group;
+        currentDepth = depth;
+        currentStats = s;
+    }
+    ~Scope() {
+        currentGroup = savedGroup;
+        currentDepth = savedDepth;
+        currentStats = savedStats;
+    }
+};
+
+// Wraps an alternative, counting how often the rule it belongs to is tried and succeeds
+template<class F>
+static auto counted(Prover::Stats::Rule rule, F f) {
+    return [rule, f]() {
+        if(auto s = stats())
+            ++s->attempts[rule];
+        bool result = f();
+        if(result)
+            if(auto s = stats())
+                ++s->successes[rule];
+        return result;
+    };
+}
+
+/*
+ * A set of alternatives that either all have to succeed (ALL) or of which one has to succeed (ANY).
+ * Sequentially, every alternative is tried right away, in order, until the outcome is decided.
+ * In parallel, the alternatives are submitted to the pool, and the first deciding alternative cancels the others.
+ */
+class Prover::Branches {
+
+    Prover& prover;
+    const bool all;
+    const bool parallel;
+    Group group;
+    std::atomic<int> running;
+    std::atomic<bool> decided;
+    std::atomic<uint64_t> cut;  // Cutoffs of the alternatives that ran on the pool, not yet added to this thread's
     
-    // If there is already an arrow, nothing new is to be shown
-    if(heyting.isArrow(x, y))
-        return true;
+public:
     
-    // If the implication "x => y" has tried to be shown before (with at least this amount of pay), then don't even bother trying
-    auto pair = std::pair<Heyting::Element*, Heyting::Element*>(x, y);
-    auto pos = map.find(pair);
-    if(pos != map.end() && pos->second >= pay)
-        return false;
-    map[pair] = pay;
+    enum Mode { ANY, ALL };
     
-    // std::cout << "Question [" << std::to_string(pay) << "]: (" << x->to_string() << ") =(?)> (" << y->to_string() << ")" << std::endl;
-  
-    // Arrows to PRODUCTS (use definition products)
-    if(y->type == Heyting::Element::PRODUCT) {
-        auto factors = ((Heyting::Product*) y)->factors;
-        bool flag = true;
-        for(auto e : factors) {
-            if(!implicationHelper(x, e, map, pay)) { // Equivalence, so zero pay
-                flag = false;
-                break;
+    Branches(Prover& p, Mode mode) : prover(p), all(mode == ALL),
+        parallel(p.pool != nullptr && currentDepth <= p.forkDepth), group(currentGroup), running(0), decided(false), cut(0) {}
+    
+    ~Branches() {
+        result();
+    }
+    
+    // Tries an alternative, and returns whether this decides the outcome
+    template<class F>
+    bool add(F f) {
+        if(decided)
+            return true;
+        
+        if(!parallel) {
+            if(f() != all)
+                decided = true;
+            return decided;
+        }
+        
+        ++running;
+        int depth = currentDepth;
+        bool counting = stats() != nullptr;
+        prover.pool->submit([this, f, depth, counting]() {
+            Stats local;
+            uint64_t before = cutoffs;
+            {
+                Scope scope(&group, depth, counting ? &local : nullptr);
+                // An alternative that is not run has not succeeded: if it was skipped because a group further up
+                // was cancelled, the alternatives of ALL must not come out as shown
+                if(group.isCancelled()) {
+                    ++cutoffs;
+                    if(all)
+                        decided = true;
+                }
+                else if(f() != all) {
+                    decided = true;
+                    group.cancelled = true;
+                }
             }
+            // The cutoffs belong to the thread that added the alternative, not to the one that happened to run it
+            cut += cutoffs - before;
+            cutoffs = before;
+            if(counting)
+                prover.collect(local);
+            --running;
+        });
+        return false;
+    }
+    
+    // Waits for all alternatives, and returns the outcome
+    bool result() {
+        if(parallel) {
+            prover.pool->wait([this]() { return running == 0; });
+            cutoffs += cut.exchange(0);
+        }
+        return decided != all;
+    }
+    
+};
+
+/*
+ * The bookkeeping around a call to implication (or implications): the memo is checked against the generation
+ * of the Heyting algebra, and the statistics are set up and collected.
+ * The calling thread counts into its own statistics, so it need not lock while parallel branches finish.
+ */
+class Prover::Session {
+
+    Prover& prover;
+    Stats& result;
+    std::chrono::steady_clock::time_point start;
+    size_t size;
+    
+public:
+    
+    Stats local;
+    
+    Session(Prover& p, Stats& r) : prover(p), result(r), start(std::chrono::steady_clock::now()), size(p.heyting.size()) {
+        // If the arrows were cleared since the last query, nothing in the memo can be trusted anymore
+        if(prover.generation != prover.heyting.generation()) {
+            prover.clearMemo();
+            prover.generation = prover.heyting.generation();
+        }
+        
+        // If child contexts were reclaimed since, only the attempts that involve their elements go
+        // (the ids of those may have been given to new elements)
+        else if(prover.reclaims != prover.heyting.reclaims()) {
+            auto gone = [this](Heyting::Id id) { return id >= size || prover.heyting.element(id)->created > prover.reclaims; };
+            for(auto& s : prover.memo)
+                for(auto pos = s.attempts.begin(); pos != s.attempts.end();)
+                    pos = gone(pos->first.first) || gone(pos->first.second) ? s.attempts.erase(pos) : std::next(pos);
+        }
+        prover.reclaims = prover.heyting.reclaims();
+        
+        result = Stats();
+        for(int pay : prover.schedule)
+            if(pay >= 0 && local.nodes.size() <= (size_t) pay)
+                local.nodes.resize(pay + 1, 0);
+        prover.collected = &result;
+        currentStats = PROVER_STATS ? &local : nullptr;
+        
+        // The elements the query creates go into a child context of their own
+        if(prover.scratch) {
+            prover.base = size;
+            prover.heyting.push();
+        }
+    }
+    
+    ~Session() {
+        if(PROVER_STATS) {
+            local.elementsCreated = prover.heyting.size() - size;
+            local.nanoseconds = nanoseconds(start);
+            result += local;
         }
+        currentStats = nullptr;
+        prover.collected = nullptr;
         
-        if(flag) {
-            heyting.putArrow(x, y);
+        // Reclaim them, keeping what was shown about the elements from before the query,
+        // and forget the attempts that involve them (their ids will be given to new elements)
+        // (other provers look for them among all of their attempts when they are next asked)
+        if(prover.scratch) {
+            prover.heyting.reclaim();
+            for(auto& s : prover.memo) {
+                for(auto& key : s.temporary)
+                    s.attempts.erase(key);
+                s.temporary.clear();
+            }
+            prover.generation = prover.heyting.generation();
+            prover.reclaims = prover.heyting.reclaims();
+        }
+    }
+    
+};
+
+/*
+ * The limits of a query, while it runs: every expanded node is counted, and checks the cancellation flag,
+ * while the clock and the number of elements are only looked at every so many nodes.
+ * Once a limit is reached, every node fails right away, and none of these failures are remembered.
+ */
+class Prover::Budget {
+
+    static const uint64_t INTERVAL = 64;
+    
+    Prover& prover;
+    const Limits& limits;
+    size_t size;
+    std::atomic<uint64_t> nodes;
+    std::atomic<bool> exhausted;
+    
+public:
+    
+    Budget(Prover& p, const Limits& l) : prover(p), limits(l), size(p.heyting.size()), nodes(0), exhausted(false) {
+        if(limits.bounded())
+            prover.budget = this;
+    }
+    
+    ~Budget() {
+        prover.budget = nullptr;
+    }
+    
+    bool spent() {
+        if(exhausted.load(std::memory_order_relaxed))
             return true;
+        
+        uint64_t n = nodes.fetch_add(1, std::memory_order_relaxed) + 1;
+        bool stop = (limits.cancel != nullptr && limits.cancel->load(std::memory_order_relaxed)) || (limits.nodes != 0 && n > limits.nodes);
+        if(!stop && n % INTERVAL == 0)
+            stop = (std::chrono::steady_clock::now() >= limits.deadline) || (limits.elements != 0 && prover.heyting.size() - size > limits.elements);
+        if(stop)
+            exhausted = true;
+        return stop;
+    }
+    
+    bool isSpent() const {
+        return exhausted;
+    }
+    
+};
+
+Prover::Limits::Limits() : deadline(std::chrono::steady_clock::time_point::max()), nodes(0), elements(0), cancel(nullptr) {
+}
+
+bool Prover::Limits::bounded() const {
+    return deadline != std::chrono::steady_clock::time_point::max() || nodes != 0 || elements != 0 || cancel != nullptr;
+}
+
+Prover::Prover(Heyting& h) : heyting(h), memo(64), query(0), generation(h.generation()), reclaims(h.reclaims()), verbose(true), tuned(true), scratch(false), base(0), schedule({ 0, 1, 2 }), forkDepth(0), collected(nullptr), budget(nullptr) {
+}
+
+Prover::~Prover() {
+    setThreads(1);
+}
+
+const char* const Prover::Stats::ruleNames[RULES] = {
+    "product_target", "coproduct_source", "exponential_target", "product_source", "functoriality",
+    "arrow_to_target", "false_to_target", "arrow_from_source", "true_to_target", "product_of_targets"
+};
+
+Prover::Stats::Stats() : rounds(0), memoHits(0), memoMisses(0), isArrowCalls(0), isArrowNanoseconds(0),
+    elementsCreated(0), arrowsAdded(0), refuted(0), attempts(), successes(), nanoseconds(0) {
+}
+
+Prover::Stats& Prover::Stats::operator+=(const Stats& other) {
+    if(nodes.size() < other.nodes.size())
+        nodes.resize(other.nodes.size(), 0);
+    for(size_t i = 0;i < other.nodes.size(); ++i)
+        nodes[i] += other.nodes[i];
+    rounds += other.rounds;
+    memoHits += other.memoHits;
+    memoMisses += other.memoMisses;
+    isArrowCalls += other.isArrowCalls;
+    isArrowNanoseconds += other.isArrowNanoseconds;
+    elementsCreated += other.elementsCreated;
+    arrowsAdded += other.arrowsAdded;
+    refuted += other.refuted;
+    for(int r = 0;r < RULES; ++r) {
+        attempts[r] += other.attempts[r];
+        successes[r] += other.successes[r];
+    }
+    nanoseconds += other.nanoseconds;
+    return *this;
+}
+
+void Prover::Stats::dump(std::ostream& out) const {
+    out << "{\"nodes\":[";
+    for(size_t i = 0;i < nodes.size(); ++i)
+        out << (i > 0 ? "," : "") << nodes[i];
+    out << "],\"rounds\":" << rounds
+        << ",\"memo_hits\":" << memoHits
+        << ",\"memo_misses\":" << memoMisses
+        << ",\"is_arrow_calls\":" << isArrowCalls
+        << ",\"is_arrow_ns\":" << isArrowNanoseconds
+        << ",\"elements_created\":" << elementsCreated
+        << ",\"arrows_added\":" << arrowsAdded
+        << ",\"refuted\":" << refuted
+        << ",\"ns\":" << nanoseconds
+        << ",\"rules\":{";
+    for(int r = 0;r < RULES; ++r)
+        out << (r > 0 ? "," : "") << "\"" << ruleNames[r] << "\":{\"attempts\":" << attempts[r] << ",\"successes\":" << successes[r] << "}";
+    out << "}}";
+}
+
+void Prover::setScratch(bool flag) {
+    scratch = flag;
+}
+
+void Prover::setRefutation(bool flag) {
+    if(!flag) {
+        countermodels.reset();
+        classical.reset();
+    }
+    else if(!classical) {
+        countermodels.reset(new Countermodels(heyting));
+        classical.reset(new Classical(heyting));
+    }
+}
+
+void Prover::setTunedRules(bool flag) {
+    tuned = flag;
+}
+
+void Prover::setVerbose(bool flag) {
+    verbose = flag;
+}
+
+void Prover::setMaxPay(int pay) {
+    schedule.clear();
+    for(int p = 0;p <= pay; ++p)
+        schedule.push_back(p);
+}
+
+void Prover::setPaySchedule(const std::vector<int>& pays) {
+    schedule = pays;
+}
+
+void Prover::setThreads(size_t n, int depth) {
+    // Every thread needs to be able to read and extend the Heyting algebra, for as long as this prover has a pool
+    // (other provers and services may share the algebra as well, so only this prover's share is given up)
+    bool shared = (pool != nullptr);
+    pool.reset(n > 1 ? new ThreadPool(n) : nullptr);
+    forkDepth = depth;
+    if(pool != nullptr && !shared)
+        heyting.setConcurrent(true);
+    else if(pool == nullptr && shared)
+        heyting.setConcurrent(false);
+}
+
+void Prover::collect(const Stats& s) {
+    std::lock_guard<std::mutex> lock(collectedMutex);
+    *collected += s;
+}
+
+Prover::Shard& Prover::shard(const Key& key) {
+    return memo[hash_pair{}(key) % memo.size()];
+}
+
+bool Prover::recall(const Key& key, Attempt& attempt) {
+    Shard& s = shard(key);
+    std::unique_lock<std::mutex> lock(s.mutex, std::defer_lock);
+    if(pool)
+        lock.lock();
+    auto pos = s.attempts.find(key);
+    if(pos == s.attempts.end())
+        return false;
+    attempt = pos->second;
+    return true;
+}
+
+void Prover::remember(const Key& key, const Attempt& attempt) {
+    Shard& s = shard(key);
+    std::unique_lock<std::mutex> lock(s.mutex, std::defer_lock);
+    if(pool)
+        lock.lock();
+    auto inserted = s.attempts.insert(std::make_pair(key, attempt));
+    if(!inserted.second)
+        inserted.first->second = attempt;
+    else if(scratch && (key.first >= base || key.second >= base))
+        s.temporary.push_back(key);
+}
+
+void Prover::forget(const Key& key) {
+    Shard& s = shard(key);
+    std::unique_lock<std::mutex> lock(s.mutex, std::defer_lock);
+    if(pool)
+        lock.lock();
+    s.attempts.erase(key);
+}
+
+bool Prover::implication(Heyting::Element* x, Heyting::Element* y) {
+    Stats ignored;
+    return implication(x, y, ignored);
+}
+
+bool Prover::implication(Heyting::Element* x, Heyting::Element* y, Stats& result) {
+    return implication(x, y, Limits(), result) == PROVED;
+}
+
+Prover::Result Prover::implication(Heyting::Element* x, Heyting::Element* y, const Limits& limits) {
+    Stats ignored;
+    return implication(x, y, limits, ignored);
+}
+
+Prover::Result Prover::implication(Heyting::Element* x, Heyting::Element* y, const Limits& limits, Stats& result) {
+    Session session(*this, result);
+    Budget b(*this, limits);
+    ++query;
+    
+    // A query that is cancelled before it starts gives up, even if the memo could answer it
+    if(limits.cancel != nullptr && limits.cancel->load(std::memory_order_relaxed))
+        return GAVE_UP;
+    
+    // What fails in a model cannot be shown at all
+    if(refutes(x, y)) {
+        ++session.local.refuted;
+        return NOT_PROVED;
+    }
+    
+    // Every round starts from the root again, but the attempts that failed without being cut off for lack of pay
+    // are final, so a round only expands the subgoals on the way to the ones the round before cut off
+    for(int pay : schedule) {
+        ++session.local.rounds;
+        if(implicationHelper(x, y, pay)) {
+            if(verbose)
+                std::cout << "Showed (" << heyting.to_string(x) << ") => (" << heyting.to_string(y) << ") with pay " << pay << std::endl;
+            return PROVED;
         }
+        if(b.isSpent())
+            return GAVE_UP;
     }
+    return NOT_PROVED;
+}
+
+std::vector<bool> Prover::implications(const std::vector<Goal>& goals) {
+    Stats ignored;
+    return implications(goals, ignored);
+}
+
+std::vector<bool> Prover::implications(const std::vector<Goal>& goals, Stats& result) {
+    Session session(*this, result);
     
-    // Arrows from COPRODUCTS (use definition coproducts)
-    if(x->type == Heyting::Element::COPRODUCT) {
-        auto factors = ((Heyting::Coproduct*) x)->factors;
-        bool flag = true;
-        for(auto e : factors) {
-            if(!implicationHelper(e, y, map, pay)) { // Equivalence, so zero pay
-                flag = false;
-                break;
+    // Try the goals with the smallest formulas first, they tend to have the cheapest proofs
+    std::vector<size_t> pending(goals.size());
+    for(size_t i = 0;i < goals.size(); ++i)
+        pending[i] = i;
+    std::stable_sort(pending.begin(), pending.end(), [&goals](size_t i, size_t j) {
+        return goals[i].first->size + goals[i].second->size < goals[j].first->size + goals[j].second->size;
+    });
+    if(classical) {
+        auto end = std::remove_if(pending.begin(), pending.end(), [this, &goals](size_t i) { return refutes(goals[i].first, goals[i].second); });
+        session.local.refuted += pending.end() - end;
+        pending.erase(end, pending.end());
+    }
+    
+    // Deepen all goals together: every goal gets a cheap attempt before any goal gets an expensive one,
+    // and every implication that is shown is stored as an arrow, for the goals that come after it
+    // (a round is a single query, so the goals in it share their failed attempts as well)
+    std::vector<char> shown(goals.size(), false);
+    for(int pay : schedule) {
+        if(pending.empty())
+            break;
+        ++session.local.rounds;
+        ++query;
+        
+        auto attempt = [this, &goals, &shown, pay](size_t i) {
+            if(implicationHelper(goals[i].first, goals[i].second, pay)) {
+                conclude(goals[i].first, goals[i].second);
+                shown[i] = true;
             }
+        };
+        
+        if(pool) {
+            std::atomic<size_t> running(pending.size());
+            bool counting = stats() != nullptr;
+            for(auto i : pending)
+                pool->submit([this, &attempt, &running, i, counting]() {
+                    Stats local;
+                    {
+                        Scope scope(nullptr, 0, counting ? &local : nullptr);
+                        attempt(i);
+                    }
+                    if(counting)
+                        collect(local);
+                    --running;
+                });
+            pool->wait([&running]() { return running == 0; });
+        }
+        else {
+            for(auto i : pending)
+                attempt(i);
         }
         
-        if(flag) {
-            heyting.putArrow(x, y);
-            return true;
+        // Report in the order of the goals, also when they were shown in parallel
+        if(verbose)
+            for(auto i : pending)
+                if(shown[i])
+                    std::cout << "Showed (" << heyting.to_string(goals[i].first) << ") => (" << heyting.to_string(goals[i].second) << ") with pay " << pay << std::endl;
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [&shown](size_t i) { return shown[i]; }), pending.end());
+    }
+    
+    return std::vector<bool>(shown.begin(), shown.end());
+}
+
+void Prover::clearMemo() {
+    for(auto& s : memo) {
+        s.attempts.clear();
+        s.temporary.clear();
+    }
+}
+
+bool Prover::implicationHelper(Heyting::Element* x, Heyting::Element* y, int pay) {
+    // Require enough pay (the next round resumes here, unless the subgoal closes a cycle or has failed for good)
+    if(pay < 0) {
+        Attempt attempt;
+        if(pool == nullptr && recall(Key(x->id, y->id), attempt) && !attempt.proved && (attempt.query == query || attempt.version == heyting.version())) {
+            if(attempt.open >= 0) {
+                cycle = std::min(cycle, attempt.open);
+                return false;
+            }
+            if(attempt.complete)
+                return false;
         }
+        ++cutoffs;
+        return false;
     }
     
-    // Arrows to EXPONENTS (use adjunction)
-    if(y->type == Heyting::Element::EXPONENTIAL) {
-        auto exp = (Heyting::Exponential*) y;
-        auto prod = heyting.product({ x, exp->exponent });
-        if(implicationHelper(prod, exp->base, map, pay)) { // Equivalence, so zero pay
-            heyting.putArrow(x, y);
-            return true;
+    // If there is already an arrow, nothing new is to be shown
+    if(isArrow(x, y))
+        return true;
+    
+    // Stop if another branch already decided the outcome
+    if(currentGroup != nullptr && currentGroup->isCancelled()) {
+        ++cutoffs;
+        return false;
+    }
+    
+    // If the implication "x => y" has been shown before, it still holds
+    // If it has tried to be shown before (with at least this amount of pay, or with nothing cut off), then don't
+    // even bother trying, unless the attempt was made in an earlier query and arrows have been added since
+    Key key(x->id, y->id);
+    Attempt attempt;
+    if(recall(key, attempt)) {
+        if(attempt.proved || ((attempt.pay >= pay || attempt.complete) && (attempt.query == query || attempt.version == heyting.version()))) {
+            if(auto s = stats())
+                ++s->memoHits;
+            // Only an attempt of this thread can be an ancestor, and the parallel search cannot tell which ones are
+            if(!attempt.proved && !attempt.complete) {
+                if(attempt.open >= 0 && pool == nullptr)
+                    cycle = std::min(cycle, attempt.open);
+                else
+                    ++cutoffs;
+            }
+            return attempt.proved;
         }
     }
+    // Expanding the node counts against the limits of the query
+    if(budget != nullptr && budget->spent()) {
+        ++cutoffs;
+        return false;
+    }
+    uint64_t before = cutoffs;
+    int outer = cycle;
+    cycle = std::numeric_limits<int>::max();
+    remember(key, Attempt { pay, false, false, currentDepth, query, heyting.version() });
+    
+    if(auto s = stats()) {
+        ++s->memoMisses;
+        if(s->nodes.size() <= (size_t) pay)
+            s->nodes.resize(pay + 1, 0);
+        ++s->nodes[pay];
+    }
+    
+    // The rules of the order in use are taken first: indexing all three dimensions at once trips GCC's bounds
+    // sanitizer, which checks the kinds against the wrong dimension
+    auto& table = rules[tuned];
+    ++currentDepth;
+    bool result = (this->*table[x->type][y->type])(x, y, pay);
+    --currentDepth;
+    
+    // The cycles back to this node are closed now, the ones to nodes above it are not
+    int reached = cycle;
+    cycle = std::min(outer, reached < currentDepth ? reached : std::numeric_limits<int>::max());
+    
+    // A cancelled attempt, or one that ran out of budget, says nothing about the implication
+    if(!result && ((currentGroup != nullptr && currentGroup->isCancelled()) || (budget != nullptr && budget->isSpent()))) {
+        forget(key);
+        ++cutoffs;
+        return false;
+    }
+    
+    remember(key, Attempt { pay, result, !result && cutoffs == before && reached >= currentDepth, -1, query, heyting.version() });
+    return result;
+}
+
+bool Prover::isArrow(Heyting::Element* x, Heyting::Element* y) {
+    auto s = stats();
+    if(s == nullptr)
+        return heyting.isArrow(x, y);
+    
+    auto start = std::chrono::steady_clock::now();
+    bool result = heyting.isArrow(x, y);
+    ++s->isArrowCalls;
+    s->isArrowNanoseconds += nanoseconds(start);
+    return result;
+}
+
+// The small models take a few word operations per element, so they go before the SAT solver
+bool Prover::refutes(Heyting::Element* x, Heyting::Element* y) {
+    if(countermodels && countermodels->refutes(x, y) != Countermodels::NONE)
+        return true;
+    return classical && classical->refutes(x, y);
+}
+
+// Stores a shown implication as an arrow
+bool Prover::conclude(Heyting::Element* x, Heyting::Element* y) {
+    heyting.putArrow(x, y);
+    if(auto s = stats())
+        ++s->arrowsAdded;
+    return true;
+}
+
+// The rules for an implication from a source of kind X to a target of kind Y
+// (the conditions on X and Y are known at compile time, so every instance only contains the rules that apply to it)
+template<Heyting::Element::Type X, Heyting::Element::Type Y, bool tuned>
+bool Prover::implicationRules(Heyting::Element* x, Heyting::Element* y, int pay) {
+    typedef Heyting::Element E;
+    Branches alternatives(*this, Branches::ANY);
+    
+    // std::cout << "Question [" << std::to_string(pay) << "]: (" << heyting.to_string(x) << ") =(?)> (" << heyting.to_string(y) << ")" << std::endl;
+    
+    // Every rule adds its alternatives, and returns whether that decided the outcome already
+    
+    // Arrows to PRODUCTS (use definition products)
+    auto productTarget = [&]() {
+        if constexpr(Y == E::PRODUCT)
+            return alternatives.add(counted(Stats::PRODUCT_TARGET, [=]() {
+                Branches factors(*this, Branches::ALL);
+                for(auto e : static_cast<Heyting::Product*>(y)->factors)
+                    if(factors.add([=]() { return implicationHelper(x, e, pay); })) // Equivalence, so zero pay
+                        break;
+                
+                if(!factors.result())
+                    return false;
+                return conclude(x, y);
+            }));
+        return false;
+    };
+    
+    // Arrows from COPRODUCTS (use definition coproducts)
+    auto coproductSource = [&]() {
+        if constexpr(X == E::COPRODUCT)
+            return alternatives.add(counted(Stats::COPRODUCT_SOURCE, [=]() {
+                Branches factors(*this, Branches::ALL);
+                for(auto e : static_cast<Heyting::Coproduct*>(x)->factors)
+                    if(factors.add([=]() { return implicationHelper(e, y, pay); })) // Equivalence, so zero pay
+                        break;
+                
+                if(!factors.result())
+                    return false;
+                return conclude(x, y);
+            }));
+        return false;
+    };
+    
+    // Arrows to EXPONENTS (use adjunction)
+    auto exponentialTarget = [&]() {
+        if constexpr(Y == E::EXPONENTIAL)
+            return alternatives.add(counted(Stats::EXPONENTIAL_TARGET, [=]() {
+                auto exp = static_cast<Heyting::Exponential*>(y);
+                auto prod = heyting.product({ x, exp->exponent });
+                if(!implicationHelper(prod, exp->base, pay)) // Equivalence, so zero pay
+                    return false;
+                return conclude(x, y);
+            }));
+        return false;
+    };
     
     // Arrows from PRODUCTS (use adjunction)
-    if(x->type == Heyting::Element::PRODUCT) {
-        auto factors = ((Heyting::Product*) x)->factors;
-        for(auto f : factors) {
-            auto subset = factors;
-            subset.erase(f);
-            auto prod = heyting.product(subset);
-            auto exp = heyting.exponential(y, f);
-            if(implicationHelper(prod, exp, map, pay)) { // Equivalence, so zero pay
-                heyting.putArrow(x, y);
-                return true;
+    auto productSource = [&]() {
+        if constexpr(X == E::PRODUCT) {
+            auto prod_x = static_cast<Heyting::Product*>(x);
+            for(size_t i = 0;i < prod_x->factors.size(); ++i) {
+                if(alternatives.add(counted(Stats::PRODUCT_SOURCE, [=]() {
+                    auto prod = heyting.productWithout(prod_x, i);
+                    auto exp = heyting.exponential(y, prod_x->factors[i]);
+                    if(!implicationHelper(prod, exp, pay)) // Equivalence, so zero pay
+                        return false;
+                    return conclude(x, y);
+                })))
+                    return true;
             }
         }
-    }
+        return false;
+    };
     
     // Use functoriality of exponentiation
-    if(x->type == Heyting::Element::EXPONENTIAL && y->type == Heyting::Element::EXPONENTIAL) {
-        auto exp_x = (Heyting::Exponential*) x;
-        auto exp_y = (Heyting::Exponential*) y;
-        if(exp_x->exponent == exp_y->exponent && implicationHelper(exp_x->base, exp_y->base, map, pay - 1))
-            return true;
-    }
+    auto functoriality = [&]() {
+        if constexpr(X == E::EXPONENTIAL && Y == E::EXPONENTIAL) {
+            auto exp_x = static_cast<Heyting::Exponential*>(x);
+            auto exp_y = static_cast<Heyting::Exponential*>(y);
+            return exp_x->exponent == exp_y->exponent && alternatives.add(counted(Stats::FUNCTORIALITY, [=]() { return implicationHelper(exp_x->base, exp_y->base, pay - 1); }));
+        }
+        return false;
+    };
     
     // If z => y, then it suffices to check that x => z
-    for(auto z : y->arrowsFrom)
-        if(implicationHelper(x, z, map, pay - 1))
-            return true;
-    if(implicationHelper(x, heyting.False, map, pay - 1))
-        return true;
+    // (iterate by index, as the adjacency may grow while the search stores new arrows)
+    auto arrowsToTarget = [&]() {
+        Heyting::Element* z;
+        for(size_t i = 0;(z = heyting.arrowFrom(y, i)) != nullptr; ++i)
+            if(alternatives.add(counted(Stats::ARROW_TO_TARGET, [=]() { return implicationHelper(x, z, pay - 1); })))
+                return true;
+        return alternatives.add(counted(Stats::FALSE_TO_TARGET, [=]() { return implicationHelper(x, heyting.False, pay - 1); }));
+    };
     
     // If x => z, then it suffices to check that z => y
-    for(auto z : x->arrowsTo)
-        if(implicationHelper(z, y, map, pay - 1))
-            return true;
-    if(implicationHelper(heyting.True, y, map, pay - 1))
-        return true;
+    auto arrowsFromSource = [&]() {
+        Heyting::Element* z;
+        for(size_t i = 0;(z = heyting.arrowTo(x, i)) != nullptr; ++i)
+            if(alternatives.add(counted(Stats::ARROW_FROM_SOURCE, [=]() { return implicationHelper(z, y, pay - 1); })))
+                return true;
+        return alternatives.add(counted(Stats::TRUE_TO_TARGET, [=]() { return implicationHelper(heyting.True, y, pay - 1); }));
+    };
     
     // If x => z_i, then it suffices to show that prod(z_i) => y
-    if(implicationHelper(heyting.product(x->arrowsTo), y, map, pay - 1))
-        return true;
+    // (with fewer than two targets, this is the same as one of the two rules above, which have been tried already)
+    auto productOfTargets = [&]() {
+        return heyting.arrowTo(x, 1) != nullptr && alternatives.add(counted(Stats::PRODUCT_OF_TARGETS, [=]() { return implicationHelper(heyting.productOfTargets(x), y, pay - 1); }));
+    };
     
-    return false;
+    // The rules that are equivalences come first. After that, the tuned order follows how often every rule showed
+    // the goals of the benchmarks for the kinds at hand:
+    //  - from a plain element or an exponential to a plain element (also after the adjunction, for an exponential
+    //    target), the arrows from the source first, as the arrows into a plain target are many and rarely lead on
+    //  - from a product to a plain element, the arrows into the target before the adjunction, which creates
+    //    an exponential for every factor
+    if constexpr(tuned && (X == E::ELEMENT || X == E::EXPONENTIAL) && Y == E::ELEMENT)
+        arrowsFromSource() || arrowsToTarget() || productOfTargets();
+    else if constexpr(tuned && X == E::ELEMENT && Y == E::EXPONENTIAL)
+        exponentialTarget() || arrowsFromSource() || arrowsToTarget() || productOfTargets();
+    else if constexpr(tuned && X == E::PRODUCT && Y == E::ELEMENT)
+        arrowsToTarget() || productSource() || arrowsFromSource() || productOfTargets();
+    else
+        productTarget() || coproductSource() || exponentialTarget() || productSource() || functoriality() || arrowsToTarget() || arrowsFromSource() || productOfTargets();
+    return alternatives.result();
 }
+
+// Indexed by whether the order is tuned, the kind of the source and the kind of the target
+// (a new kind of element gets a row and a column)
+const Prover::Rules Prover::rules[2][4][4] = {
+    {
+        {
+            &Prover::implicationRules<Heyting::Element::ELEMENT, Heyting::Element::ELEMENT, false>,
+            &Prover::implicationRules<Heyting::Element::ELEMENT, Heyting::Element::PRODUCT, false>,
+            &Prover::implicationRules<Heyting::Element::ELEMENT, Heyting::Element::COPRODUCT, false>,
+            &Prover::implicationRules<Heyting::Element::ELEMENT, Heyting::Element::EXPONENTIAL, false>
+        },
+        {
+            &Prover::implicationRules<Heyting::Element::PRODUCT, Heyting::Element::ELEMENT, false>,
+            &Prover::implicationRules<Heyting::Element::PRODUCT, Heyting::Element::PRODUCT, false>,
+            &Prover::implicationRules<Heyting::Element::PRODUCT, Heyting::Element::COPRODUCT, false>,
+            &Prover::implicationRules<Heyting::Element::PRODUCT, Heyting::Element::EXPONENTIAL, false>
+        },
+        {
+            &Prover::implicationRules<Heyting::Element::COPRODUCT, Heyting::Element::ELEMENT, false>,
+            &Prover::implicationRules<Heyting::Element::COPRODUCT, Heyting::Element::PRODUCT, false>,
+            &Prover::implicationRules<Heyting::Element::COPRODUCT, Heyting::Element::COPRODUCT, false>,
+            &Prover::implicationRules<Heyting::Element::COPRODUCT, Heyting::Element::EXPONENTIAL, false>
+        },
+        {
+            &Prover::implicationRules<Heyting::Element::EXPONENTIAL, Heyting::Element::ELEMENT, false>,
+            &Prover::implicationRules<Heyting::Element::EXPONENTIAL, Heyting::Element::PRODUCT, false>,
+            &Prover::implicationRules<Heyting::Element::EXPONENTIAL, Heyting::Element::COPRODUCT, false>,
+            &Prover::implicationRules<Heyting::Element::EXPONENTIAL, Heyting::Element::EXPONENTIAL, false>
+        }
+    },
+    {
+        {
+            &Prover::implicationRules<Heyting::Element::ELEMENT, Heyting::Element::ELEMENT, true>,
+            &Prover::implicationRules<Heyting::Element::ELEMENT, Heyting::Element::PRODUCT, true>,
+            &Prover::implicationRules<Heyting::Element::ELEMENT, Heyting::Element::COPRODUCT, true>,
+            &Prover::implicationRules<Heyting::Element::ELEMENT, Heyting::Element::EXPONENTIAL, true>
+        },
+        {
+            &Prover::implicationRules<Heyting::Element::PRODUCT, Heyting::Element::ELEMENT, true>,
+            &Prover::implicationRules<Heyting::Element::PRODUCT, Heyting::Element::PRODUCT, true>,
+            &Prover::implicationRules<Heyting::Element::PRODUCT, Heyting::Element::COPRODUCT, true>,
+            &Prover::implicationRules<Heyting::Element::PRODUCT, Heyting::Element::EXPONENTIAL, true>
+        },
+        {
+            &Prover::implicationRules<Heyting::Element::COPRODUCT, Heyting::Element::ELEMENT, true>,
+            &Prover::implicationRules<Heyting::Element::COPRODUCT, Heyting::Element::PRODUCT, true>,
+            &Prover::implicationRules<Heyting::Element::COPRODUCT, Heyting::Element::COPRODUCT, true>,
+            &Prover::implicationRules<Heyting::Element::COPRODUCT, Heyting::Element::EXPONENTIAL, true>
+        },
+        {
+            &Prover::implicationRules<Heyting::Element::EXPONENTIAL, Heyting::Element::ELEMENT, true>,
+            &Prover::implicationRules<Heyting::Element::EXPONENTIAL, Heyting::Element::PRODUCT, true>,
+            &Prover::implicationRules<Heyting::Element::EXPONENTIAL, Heyting::Element::COPRODUCT, true>,
+            &Prover::implicationRules<Heyting::Element::EXPONENTIAL, Heyting::Element::EXPONENTIAL, true>
+        }
+    }
+};
@@ -2,21 +2,181 @@
 #define prover_hpp
 
 #include "heyting.hpp"
+#include "threadpool.hpp"
+#include "classical.hpp"
+#include "countermodels.hpp"
 #include <unordered_set>
 #include "hashpair.hpp"
 #include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <chrono>
+
+// Set to 0 to compile the search statistics out of the prover
+#ifndef PROVER_STATS
+#define PROVER_STATS 1
+#endif
 
 class Prover {
 
     Heyting& heyting;
     
-    bool implicationHelper(Heyting::Element*, Heyting::Element*, std::unordered_map<std::pair<Heyting::Element*, Heyting::Element*>, int, hash_pair>&, int);
+    // Outcome of an earlier attempt to show an implication, kept across calls to implication
+    struct Attempt {
+        int pay;            // Largest pay with which the implication was attempted
+        bool proved;
+        bool complete;      // Failed without running out of pay anywhere in the search, so more pay would not help
+        int open;           // Depth in the search of the attempt while it is being made, -1 once it has finished
+        uint64_t query;     // Call to implication during which the attempt was made
+        uint64_t version;   // Version of the Heyting algebra when the attempt finished
+    };
+    
+    typedef std::pair<Heyting::Id, Heyting::Id> Key;
+    
+    // The memo is split into shards, which are locked independently when proving in parallel
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, Attempt, hash_pair> attempts;
+        std::vector<Key> temporary;     // Keys that involve elements the current query will reclaim
+    };
+    
+    std::vector<Shard> memo;
+    uint64_t query;
+    uint64_t generation;
+    uint64_t reclaims;
+    
+    bool verbose;
+    bool tuned;
+    
+    // Whether the elements a query creates are reclaimed when it ends (the ones from before have ids below base)
+    bool scratch;
+    size_t base;
+    
+    // Pay of the successive rounds of iterative deepening
+    std::vector<int> schedule;
+    
+    // Parallel search: alternatives close to the root of the search are spread over the pool
+    std::unique_ptr<ThreadPool> pool;
+    int forkDepth;
+    
+    // Countermodels, looked for before the search if set: first in small Kripke models, then by the SAT solver
+    std::unique_ptr<Countermodels> countermodels;
+    std::unique_ptr<Classical> classical;
+    
+    class Branches;
+    class Session;
+    
+    Shard& shard(const Key&);
+    bool recall(const Key&, Attempt&);
+    void remember(const Key&, const Attempt&);
+    void forget(const Key&);
+    
+    bool implicationHelper(Heyting::Element*, Heyting::Element*, int);
+    template<Heyting::Element::Type, Heyting::Element::Type, bool>
+    bool implicationRules(Heyting::Element*, Heyting::Element*, int);
+    
+    // The rules that apply to an implication, by whether their order is tuned, and the kinds of its source and target
+    typedef bool (Prover::*Rules)(Heyting::Element*, Heyting::Element*, int);
+    static const Rules rules[2][4][4];
+    bool isArrow(Heyting::Element*, Heyting::Element*);
+    bool refutes(Heyting::Element*, Heyting::Element*);
+    bool conclude(Heyting::Element*, Heyting::Element*);
     
 public:
-
-    Prover(Heyting& h) : heyting(h) {};
+    
+    // What the search did while answering a query (all zero if compiled without PROVER_STATS)
+    struct Stats {
+        enum Rule {
+            PRODUCT_TARGET,         // x => (y_1 ^ ... ^ y_n) by showing x => y_i
+            COPRODUCT_SOURCE,       // (x_1 v ... v x_n) => y by showing x_i => y
+            EXPONENTIAL_TARGET,     // x => (e => b) by showing x ^ e => b
+            PRODUCT_SOURCE,         // (x_1 ^ ... ^ x_n) => y by showing (x_1 ^ ... ^ x_n-1) => (x_n => y)
+            FUNCTORIALITY,          // (e => a) => (e => b) by showing a => b
+            ARROW_TO_TARGET,        // x => y by showing x => z for an arrow z => y
+            FALSE_TO_TARGET,        // x => y by showing x => False
+            ARROW_FROM_SOURCE,      // x => y by showing z => y for an arrow x => z
+            TRUE_TO_TARGET,         // x => y by showing True => y
+            PRODUCT_OF_TARGETS,     // x => y by showing (z_1 ^ ... ^ z_n) => y for the arrows x => z_i
+            RULES
+        };
+        static const char* const ruleNames[RULES];
+        
+        std::vector<uint64_t> nodes;    // Nodes expanded, by remaining pay
+        uint64_t rounds;                // Rounds of iterative deepening
+        uint64_t memoHits;              // Nodes decided by an earlier attempt
+        uint64_t memoMisses;
+        uint64_t isArrowCalls;
+        uint64_t isArrowNanoseconds;
+        uint64_t elementsCreated;       // Products and exponentials introduced by the search
+        uint64_t arrowsAdded;           // Arrows stored in the Heyting algebra by the search
+        uint64_t refuted;               // Goals with a countermodel, which were not searched
+        uint64_t attempts[RULES];
+        uint64_t successes[RULES];
+        uint64_t nanoseconds;           // Total time spent in implication
+        
+        Stats();
+        Stats& operator+=(const Stats&);
+        
+        // Writes the statistics as a single JSON object
+        void dump(std::ostream&) const;
+    };
+    
+    // Bounds on a single query, of which the first one reached makes it give up
+    struct Limits {
+        std::chrono::steady_clock::time_point deadline;     // time_point::max() for none
+        uint64_t nodes;                                     // Nodes expanded, 0 for no limit
+        uint64_t elements;                                  // Elements created, 0 for no limit
+        const std::atomic<bool>* cancel;                    // Set by another thread to stop the query, if not null
+        
+        Limits();
+        bool bounded() const;
+    };
+    
+    enum Result {
+        PROVED,
+        NOT_PROVED,     // All rounds of the schedule failed within the limits
+        GAVE_UP         // A limit was reached first
+    };
+    
+private:
+    
+    // Statistics of the current query, which parallel branches add to when they finish
+    Stats* collected;
+    std::mutex collectedMutex;
+    
+    void collect(const Stats&);
+    
+    // What is left of the limits of the current query, if it has any
+    class Budget;
+    Budget* budget;
+    
+public:
+    
+    Prover(Heyting&);
+    ~Prover();
     
     bool implication(Heyting::Element*, Heyting::Element*);
+    bool implication(Heyting::Element*, Heyting::Element*, Stats&);
+    Result implication(Heyting::Element*, Heyting::Element*, const Limits&);
+    Result implication(Heyting::Element*, Heyting::Element*, const Limits&, Stats&);
+    
+    // Shows many implications at once, sharing the search between them
+    typedef std::pair<Heyting::Element*, Heyting::Element*> Goal;
+    std::vector<bool> implications(const std::vector<Goal>&);
+    std::vector<bool> implications(const std::vector<Goal>&, Stats&);
+    void clearMemo();
+    
+    void setThreads(size_t, int = 3);
+    void setVerbose(bool);
+    void setScratch(bool);
+    void setRefutation(bool);
+    // Whether the rules are tried in an order of their own for every kind of source and target (the default),
+    // or in the same fixed order for all of them
+    void setTunedRules(bool);
+    void setMaxPay(int);
+    void setPaySchedule(const std::vector<int>&);
     
 };
 
@@ -0,0 +1,265 @@
+#include "reachability.hpp"
+#include <algorithm>
+
+void Reachability::clear() {
+    rows.clear();
+    columns.clear();
+}
+
+bool Reachability::test(const std::vector<uint64_t>& row, uint32_t y) {
+    size_t word = y / 64;
+    return word < row.size() && (row[word] >> (y % 64) & 1);
+}
+
+// ORs the source into the target (which may be the source itself)
+void Reachability::merge(std::vector<uint64_t>& target, const std::vector<uint64_t>& source) {
+    if(target.size() < source.size())
+        target.resize(source.size(), 0);
+    for(size_t i = 0;i < source.size(); ++i)
+        target[i] |= source[i];
+}
+
+void Reachability::addVertex() {
+    // Every vertex reaches itself
+    uint32_t x = (uint32_t) rows.size();
+    rows.emplace_back(x / 64 + 1, 0);
+    rows.back()[x / 64] |= uint64_t(1) << (x % 64);
+    columns.emplace_back(rows.back());
+}
+
+void Reachability::addEdge(uint32_t x, uint32_t y) {
+    // If y is already reachable from x, nothing changes
+    if(test(rows[x], y))
+        return;
+    
+    // Everything that reaches x (but not y yet) now also reaches everything reachable from y (but not from x yet)
+    // Both sets are taken before either matrix changes, as the column of y and the row of x are among the ones that do
+    std::vector<uint32_t> sources, targets;
+    const std::vector<uint64_t>& reaching = columns[x];
+    const std::vector<uint64_t>& reached = rows[y];
+    for(size_t i = 0;i < reaching.size(); ++i)
+        for(uint64_t word = reaching[i] & ~(i < columns[y].size() ? columns[y][i] : 0); word != 0; word &= word - 1)
+            sources.push_back((uint32_t) (i * 64 + __builtin_ctzll(word)));
+    for(size_t i = 0;i < reached.size(); ++i)
+        for(uint64_t word = reached[i] & ~(i < rows[x].size() ? rows[x][i] : 0); word != 0; word &= word - 1)
+            targets.push_back((uint32_t) (i * 64 + __builtin_ctzll(word)));
+    
+    // The row of y only changes if y reaches x, and then it is merged into itself, so it need not be copied
+    // (and the same for the column of x)
+    for(auto u : sources)
+        merge(rows[u], reached);
+    for(auto v : targets)
+        merge(columns[v], reaching);
+}
+
+bool Reachability::reaches(uint32_t x, uint32_t y) const {
+    return test(rows[x], y);
+}
+
+void Reachability::build(size_t n, const std::vector<std::pair<uint32_t, uint32_t>>& edges) {
+    // The columns are the closure of the reversed edges
+    std::vector<std::pair<uint32_t, uint32_t>> reversed;
+    reversed.reserve(edges.size());
+    for(auto& e : edges)
+        reversed.emplace_back(e.second, e.first);
+    close(n, edges, rows);
+    close(n, reversed, columns);
+}
+
+std::vector<uint32_t> Reachability::stale(size_t n) const {
+    std::vector<uint32_t> result;
+    for(uint32_t x = 0;x < n; ++x) {
+        auto& row = rows[x];
+        for(size_t i = n / 64;i < row.size(); ++i) {
+            uint64_t word = i == n / 64 ? row[i] >> (n % 64) : row[i];
+            if(word != 0) {
+                result.push_back(x);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+void Reachability::shrink(size_t n, const std::vector<uint32_t>& stale, const std::vector<std::pair<uint32_t, uint32_t>>& edges) {
+    // Everything is cut off at n first, so that the rows that are still exact can be merged as they are
+    size_t words = (n + 63) / 64;
+    auto cut = [n, words](std::vector<uint64_t>& bits) {
+        if(bits.size() > words)
+            bits.resize(words);
+        if(bits.size() == words && n % 64 != 0)
+            bits.back() &= (uint64_t(1) << (n % 64)) - 1;
+    };
+    rows.resize(n);
+    columns.resize(n);
+    for(auto& row : rows)
+        cut(row);
+    for(auto& column : columns)
+        cut(column);
+    
+    // The edges by stale source, in compressed sparse row form
+    const uint32_t NONE = 0xffffffff;
+    std::vector<uint32_t> position(n, NONE), start(stale.size() + 1, 0), targets(edges.size());
+    for(uint32_t k = 0;k < stale.size(); ++k)
+        position[stale[k]] = k;
+    for(auto& e : edges)
+        ++start[position[e.first] + 1];
+    for(size_t k = 0;k < stale.size(); ++k)
+        start[k + 1] += start[k];
+    {
+        std::vector<uint32_t> next(start.begin(), start.end() - 1);
+        for(auto& e : edges)
+            targets[next[position[e.first]]++] = e.second;
+    }
+    
+    // A search from every stale vertex, which goes on through the stale vertices and takes over the rows of the others
+    // (those only reach vertices that are not stale either, or they would be stale themselves)
+    std::vector<std::vector<uint64_t>> fresh(stale.size());
+    std::vector<uint32_t> visited(n, NONE), open;
+    for(uint32_t k = 0;k < stale.size(); ++k) {
+        auto& row = fresh[k];
+        row.assign(words, 0);
+        row[stale[k] / 64] |= uint64_t(1) << (stale[k] % 64);
+        visited[stale[k]] = k;
+        open.push_back(k);
+        while(!open.empty()) {
+            uint32_t v = open.back();
+            open.pop_back();
+            for(uint32_t j = start[v];j < start[v + 1]; ++j) {
+                uint32_t w = targets[j];
+                if(visited[w] == k)
+                    continue;
+                visited[w] = k;
+                row[w / 64] |= uint64_t(1) << (w % 64);
+                if(position[w] != NONE)
+                    open.push_back(position[w]);
+                else
+                    merge(row, rows[w]);
+            }
+        }
+    }
+    
+    // The columns only differ in the bits of the stale vertices
+    for(uint32_t k = 0;k < stale.size(); ++k) {
+        uint32_t x = stale[k];
+        for(uint32_t y = 0;y < n; ++y) {
+            auto& column = columns[y];
+            if(test(fresh[k], y)) {
+                if(column.size() <= x / 64)
+                    column.resize(x / 64 + 1, 0);
+                column[x / 64] |= uint64_t(1) << (x % 64);
+            }
+            else if(x / 64 < column.size())
+                column[x / 64] &= ~(uint64_t(1) << (x % 64));
+        }
+    }
+    for(uint32_t k = 0;k < stale.size(); ++k)
+        rows[stale[k]] = std::move(fresh[k]);
+}
+
+// The vertices of a strongly connected component all reach the same vertices, so the closure is computed
+// once per component: Tarjan's algorithm finds the components in reverse topological order, so by the time
+// a component is finished, the rows of all components it has edges to are complete, and its row is their union
+void Reachability::close(size_t n, const std::vector<std::pair<uint32_t, uint32_t>>& edges, std::vector<std::vector<uint64_t>>& closure) {
+    // The edges by source, in compressed sparse row form
+    std::vector<uint32_t> start(n + 1, 0), targets(edges.size());
+    for(auto& e : edges)
+        ++start[e.first + 1];
+    for(size_t v = 0;v < n; ++v)
+        start[v + 1] += start[v];
+    {
+        std::vector<uint32_t> next(start.begin(), start.end() - 1);
+        for(auto& e : edges)
+            targets[next[e.first]++] = e.second;
+    }
+    
+    // Tarjan's algorithm, with an explicit stack instead of recursion
+    const uint32_t NONE = 0xffffffff;
+    std::vector<uint32_t> index(n, NONE), low(n), component(n, NONE);
+    std::vector<uint32_t> open, calls, positions;
+    uint32_t counter = 0, components = 0;
+    for(uint32_t s = 0;s < n; ++s) {
+        if(index[s] != NONE)
+            continue;
+        
+        index[s] = low[s] = counter++;
+        open.push_back(s);
+        calls.push_back(s);
+        positions.push_back(start[s]);
+        while(!calls.empty()) {
+            uint32_t v = calls.back();
+            uint32_t p = positions.back();
+            if(p < start[v + 1]) {
+                positions.back() = p + 1;
+                uint32_t w = targets[p];
+                if(index[w] == NONE) {
+                    index[w] = low[w] = counter++;
+                    open.push_back(w);
+                    calls.push_back(w);
+                    positions.push_back(start[w]);
+                }
+                else if(component[w] == NONE)
+                    low[v] = std::min(low[v], index[w]);
+                continue;
+            }
+            
+            calls.pop_back();
+            positions.pop_back();
+            if(!calls.empty())
+                low[calls.back()] = std::min(low[calls.back()], low[v]);
+            if(low[v] == index[v]) {
+                uint32_t w;
+                do {
+                    w = open.back();
+                    open.pop_back();
+                    component[w] = components;
+                } while(w != v);
+                ++components;
+            }
+        }
+    }
+    
+    // The members of every component, grouped by component
+    std::vector<uint32_t> first(components + 1, 0), members(n);
+    for(uint32_t v = 0;v < n; ++v)
+        ++first[component[v] + 1];
+    for(uint32_t c = 0;c < components; ++c)
+        first[c + 1] += first[c];
+    {
+        std::vector<uint32_t> next(first.begin(), first.end() - 1);
+        for(uint32_t v = 0;v < n; ++v)
+            members[next[component[v]]++] = v;
+    }
+    
+    // The row of a component: its own members, and the rows of the components it has edges to (each of them once)
+    size_t words = (n + 63) / 64;
+    std::vector<std::vector<uint64_t>> reached(components);
+    std::vector<uint32_t> merged(components, NONE);
+    for(uint32_t c = 0;c < components; ++c) {
+        auto& row = reached[c];
+        row.assign(words, 0);
+        merged[c] = c;
+        for(uint32_t i = first[c];i < first[c + 1]; ++i) {
+            uint32_t v = members[i];
+            row[v / 64] |= uint64_t(1) << (v % 64);
+            for(uint32_t j = start[v];j < start[v + 1]; ++j) {
+                uint32_t d = component[targets[j]];
+                if(merged[d] == c)
+                    continue;
+                merged[d] = c;
+                const uint64_t* other = reached[d].data();
+                uint64_t* target = row.data();
+                for(size_t k = 0;k < words; ++k)
+                    target[k] |= other[k];
+            }
+        }
+    }
+    
+    // Every vertex gets the row of its component (the first member takes it over)
+    closure.assign(n, std::vector<uint64_t>());
+    for(uint32_t c = 0;c < components; ++c) {
+        for(uint32_t i = first[c] + 1;i < first[c + 1]; ++i)
+            closure[members[i]] = reached[c];
+        closure[members[first[c]]] = std::move(reached[c]);
+    }
+}
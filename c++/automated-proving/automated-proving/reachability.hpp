@@ -0,0 +1,41 @@
+#ifndef reachability_hpp
+#define reachability_hpp
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+class Reachability {
+
+    // The transitive closure as a bit matrix: bit y of row x is set iff y is reachable from x
+    // The columns are the same matrix transposed (bit x of column y is set iff x reaches y), so that an edge
+    // only has to visit the rows of the vertices that reach its source
+    std::vector<std::vector<uint64_t>> rows;
+    std::vector<std::vector<uint64_t>> columns;
+    
+    static bool test(const std::vector<uint64_t>&, uint32_t);
+    static void merge(std::vector<uint64_t>&, const std::vector<uint64_t>&);
+    static void close(size_t, const std::vector<std::pair<uint32_t, uint32_t>>&, std::vector<std::vector<uint64_t>>&);
+    
+public:
+    
+    size_t size() const { return rows.size(); }
+    
+    void clear();
+    void addVertex();
+    void addEdge(uint32_t, uint32_t);
+    bool reaches(uint32_t, uint32_t) const;
+    
+    // Replaces the index by the closure of the given edges between n vertices, computed in one pass
+    void build(size_t, const std::vector<std::pair<uint32_t, uint32_t>>&);
+    
+    // The vertices below n that reach any vertex from n on
+    std::vector<uint32_t> stale(size_t) const;
+    // Drops the vertices from n on. The stale vertices may have reached others only through them, so their rows are
+    // computed again from the given edges out of them (the other rows are still exact, and stay as they are)
+    void shrink(size_t, const std::vector<uint32_t>&, const std::vector<std::pair<uint32_t, uint32_t>>&);
+    
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include "saturation.hpp"
+
+Saturation::Saturation(Heyting& h) : heyting(h), generation(h.generation()), elements(0) {
+}
+
+bool Saturation::test(const std::vector<uint64_t>& row, Id y) {
+    return row[y / 64] >> (y % 64) & 1;
+}
+
+void Saturation::set(std::vector<uint64_t>& row, Id y) {
+    row[y / 64] |= uint64_t(1) << (y % 64);
+}
+
+bool Saturation::implies(Heyting::Element* x, Heyting::Element* y) const {
+    return x->id < elements && y->id < elements && test(above[x->id], y->id);
+}
+
+void Saturation::reset() {
+    elements = 0;
+    above.clear();
+    below.clear();
+    products.clear();
+    coproducts.clear();
+    byBase.clear();
+    byExponent.clear();
+    delta.clear();
+    derived.clear();
+}
+
+size_t Saturation::saturate() {
+    // Cleared arrows cannot be taken back, so start over
+    if(generation != heyting.generation()) {
+        reset();
+        generation = heyting.generation();
+    }
+    
+    // Take the new elements into account, in order, so that factors come before the elements built from them
+    size_t n = heyting.size();
+    if(n > elements) {
+        grow(n);
+        for(size_t i = elements;i < n; ++i) {
+            elements = i + 1;
+            seed(heyting.element((Id) i));
+            run();
+        }
+    }
+    
+    // Take all arrows into account (the ones that are known already are skipped right away)
+    // (the arrows stored at True and False themselves are left out, just like clearArrows leaves them)
+    for(Id i = 0;i < n; ++i) {
+        auto y = heyting.element(i);
+        if(y == heyting.True || y == heyting.False)
+            continue;
+        
+        for(auto x : y->arrowsFrom) {
+            add(x, y, false);
+            run();
+        }
+        if(y->arrowsTo.contains(heyting.False)) {
+            add(y, heyting.False, false);
+            run();
+        }
+    }
+    
+    // Store the derived arrows, from which isArrow finds the others by transitivity
+    size_t stored = 0;
+    for(auto& arrow : derived) {
+        if(arrow.first->arrowsTo.contains(arrow.second))
+            continue;
+        heyting.putArrow(arrow.first, arrow.second);
+        ++stored;
+    }
+    derived.clear();
+    return stored;
+}
+
+void Saturation::grow(size_t n) {
+    size_t words = (n + 63) / 64;
+    for(auto& row : above)
+        row.resize(words, 0);
+    for(auto& row : below)
+        row.resize(words, 0);
+    above.resize(n, std::vector<uint64_t>(words, 0));
+    below.resize(n, std::vector<uint64_t>(words, 0));
+    products.resize(n);
+    coproducts.resize(n);
+    byBase.resize(n);
+    byExponent.resize(n);
+}
+
+void Saturation::seed(Heyting::Element* x) {
+    auto True = heyting.True;
+    auto False = heyting.False;
+    
+    // Identity arrows, and the arrows from False and to True
+    set(above[x->id], x->id);
+    set(below[x->id], x->id);
+    add(x, True, false);
+    add(False, x, false);
+    
+    switch(x->type) {
+        case Heyting::Element::PRODUCT: {
+            // Everything with an arrow to all of the factors has an arrow to the product
+            auto& factors = ((Heyting::Product*) x)->factors;
+            std::vector<uint64_t> common = below[(*factors.begin())->id];
+            for(auto f : factors) {
+                products[f->id].push_back(x);
+                for(size_t i = 0;i < common.size(); ++i)
+                    common[i] &= below[f->id][i];
+            }
+            for(size_t i = 0;i < common.size(); ++i)
+                for(uint64_t word = common[i]; word != 0; word &= word - 1)
+                    add(heyting.element((Id) (i * 64 + __builtin_ctzll(word))), x, true);
+            break;
+        }
+        
+        case Heyting::Element::COPRODUCT: {
+            // Everything with an arrow from all of the factors has an arrow from the coproduct
+            auto& factors = ((Heyting::Coproduct*) x)->factors;
+            std::vector<uint64_t> common = above[(*factors.begin())->id];
+            for(auto f : factors) {
+                coproducts[f->id].push_back(x);
+                for(size_t i = 0;i < common.size(); ++i)
+                    common[i] &= above[f->id][i];
+            }
+            for(size_t i = 0;i < common.size(); ++i)
+                for(uint64_t word = common[i]; word != 0; word &= word - 1)
+                    add(x, heyting.element((Id) (i * 64 + __builtin_ctzll(word))), true);
+            break;
+        }
+        
+        case Heyting::Element::EXPONENTIAL: {
+            auto exp = (Heyting::Exponential*) x;
+            auto b = exp->base, e = exp->exponent;
+            byBase[b->id].push_back(x);
+            byExponent[e->id].push_back(x);
+            
+            // b => (e => b), as b ^ e => b
+            add(b, x, true);
+            
+            // If z ^ e => b, then z => (e => b)
+            std::vector<uint64_t> sources = below[b->id];
+            for(size_t i = 0;i < sources.size(); ++i)
+                for(uint64_t word = sources[i]; word != 0; word &= word - 1) {
+                    auto z = quotient(heyting.element((Id) (i * 64 + __builtin_ctzll(word))), e);
+                    if(z != nullptr)
+                        add(z, x, true);
+                }
+            
+            // Functoriality, with respect to the other exponentials with the same exponent or the same base
+            for(auto other : byExponent[e->id]) {
+                auto b2 = ((Heyting::Exponential*) other)->base;
+                if(other != x && test(above[b->id], b2->id))
+                    add(x, other, true);
+                if(other != x && test(above[b2->id], b->id))
+                    add(other, x, true);
+            }
+            for(auto other : byBase[b->id]) {
+                auto e2 = ((Heyting::Exponential*) other)->exponent;
+                if(other != x && test(above[e2->id], e->id))
+                    add(x, other, true);
+                if(other != x && test(above[e->id], e2->id))
+                    add(other, x, true);
+            }
+            break;
+        }
+        
+        default:
+            break;
+    }
+}
+
+void Saturation::add(Heyting::Element* x, Heyting::Element* y, bool rule) {
+    if(test(above[x->id], y->id))
+        return;
+    if(rule)
+        derived.push_back(std::make_pair(x, y));
+    
+    // Transitivity: everything with an arrow to x gets an arrow to everything y has an arrow to
+    // (y itself included, as every element has an identity arrow)
+    std::vector<Id> sources;
+    const auto& column = below[x->id];
+    for(size_t i = 0;i < column.size(); ++i)
+        for(uint64_t word = column[i]; word != 0; word &= word - 1)
+            sources.push_back((Id) (i * 64 + __builtin_ctzll(word)));
+    const std::vector<uint64_t> targets = above[y->id];
+    
+    for(auto w : sources) {
+        auto& row = above[w];
+        for(size_t i = 0;i < targets.size(); ++i) {
+            uint64_t fresh = targets[i] & ~row[i];
+            row[i] |= fresh;
+            for(;fresh != 0; fresh &= fresh - 1) {
+                Id z = (Id) (i * 64 + __builtin_ctzll(fresh));
+                set(below[z], w);
+                delta.emplace_back(w, z);
+            }
+        }
+    }
+}
+
+void Saturation::run() {
+    while(!delta.empty()) {
+        auto arrow = delta.front();
+        delta.pop_front();
+        consequences(heyting.element(arrow.first), heyting.element(arrow.second));
+    }
+}
+
+// The rules, applied to a new arrow x => y (the other premises are looked up in the arrows derived so far)
+void Saturation::consequences(Heyting::Element* x, Heyting::Element* y) {
+    // If x => False, then x is isomorphic to False, which isArrow only recognizes by a direct arrow
+    if(y == heyting.False && x != heyting.False && !x->arrowsTo.contains(heyting.False))
+        derived.push_back(std::make_pair(x, y));
+    
+    // If x => y and x => f for the other factors f of a product, then x => product
+    for(auto prod : products[y->id]) {
+        bool all = true;
+        for(auto f : ((Heyting::Product*) prod)->factors)
+            all &= test(above[x->id], f->id);
+        if(all)
+            add(x, prod, true);
+    }
+    
+    // If x => y and f => y for the other factors f of a coproduct, then coproduct => y
+    for(auto coprod : coproducts[x->id]) {
+        bool all = true;
+        for(auto f : ((Heyting::Coproduct*) coprod)->factors)
+            all &= test(above[f->id], y->id);
+        if(all)
+            add(coprod, y, true);
+    }
+    
+    // Modus ponens: if x => (e => b) and x => e, then x => b
+    if(y->type == Heyting::Element::EXPONENTIAL) {
+        auto exp = (Heyting::Exponential*) y;
+        if(test(above[x->id], exp->exponent->id))
+            add(x, exp->base, true);
+    }
+    for(auto exp : byExponent[y->id])
+        if(test(above[x->id], exp->id))
+            add(x, ((Heyting::Exponential*) exp)->base, true);
+    
+    // Adjunction: if z ^ e => y, then z => (e => y)
+    for(auto exp : byBase[y->id]) {
+        auto z = quotient(x, ((Heyting::Exponential*) exp)->exponent);
+        if(z != nullptr)
+            add(z, exp, true);
+    }
+    
+    // Functoriality: (e => x) => (e => y), and (y => b) => (x => b)
+    // (only for exponentials that exist, and have been taken into account already)
+    for(auto exp : byBase[x->id]) {
+        auto other = heyting.exponential(y, ((Heyting::Exponential*) exp)->exponent, false);
+        if(other != nullptr && other->id < elements)
+            add(exp, other, true);
+    }
+    for(auto exp : byExponent[y->id]) {
+        auto other = heyting.exponential(((Heyting::Exponential*) exp)->base, x, false);
+        if(other != nullptr && other->id < elements)
+            add(exp, other, true);
+    }
+}
+
+// The existing element z with z ^ e == x, if any (True if x == e)
+Heyting::Element* Saturation::quotient(Heyting::Element* x, Heyting::Element* e) {
+    std::set<Heyting::Element*> factors;
+    if(x->type == Heyting::Element::PRODUCT)
+        factors.insert(((Heyting::Product*) x)->factors.begin(), ((Heyting::Product*) x)->factors.end());
+    else
+        factors.insert(x);
+    
+    if(e->type == Heyting::Element::PRODUCT) {
+        for(auto f : ((Heyting::Product*) e)->factors)
+            if(factors.erase(f) == 0)
+                return nullptr;
+    }
+    else if(factors.erase(e) == 0) {
+        return nullptr;
+    }
+    
+    auto z = heyting.product(factors, false);
+    if(z == nullptr || z->id >= elements)
+        return nullptr;
+    return z;
+}
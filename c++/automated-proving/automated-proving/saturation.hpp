@@ -0,0 +1,55 @@
+#ifndef saturation_hpp
+#define saturation_hpp
+
+#include <vector>
+#include <deque>
+#include <utility>
+#include "heyting.hpp"
+
+/*
+ * Forward chaining: derives the arrows between the existing elements of a Heyting algebra that follow from
+ * the universal properties of products and coproducts, modus ponens, the adjunction of exponentials and transitivity,
+ * until a fixpoint is reached. The derived arrows are stored in the algebra, so that afterwards isArrow alone answers them.
+ * Saturating again only takes the elements and arrows into account that were added in the meantime.
+ */
+class Saturation {
+
+    typedef Heyting::Id Id;
+    
+    Heyting& heyting;
+    uint64_t generation;
+    size_t elements;    // Number of elements of the algebra taken into account so far
+    
+    // The derived arrows as a bit matrix and its transpose: bit y of above[x] (and bit x of below[y]) is set iff x => y
+    std::vector<std::vector<uint64_t>> above, below;
+    
+    // For every element, the products and coproducts it is a factor of, and the exponentials it is the base or exponent of
+    std::vector<std::vector<Heyting::Element*>> products, coproducts, byBase, byExponent;
+    
+    // Arrows of which the consequences have not been drawn yet (semi-naive evaluation: every arrow is looked at once)
+    std::deque<std::pair<Id, Id>> delta;
+    
+    // Arrows derived by the rules (and not by transitivity), which are stored in the algebra at the end
+    std::vector<std::pair<Heyting::Element*, Heyting::Element*>> derived;
+    
+    static bool test(const std::vector<uint64_t>&, Id);
+    static void set(std::vector<uint64_t>&, Id);
+    
+    void reset();
+    void grow(size_t);
+    void seed(Heyting::Element*);
+    void add(Heyting::Element*, Heyting::Element*, bool);
+    void run();
+    void consequences(Heyting::Element*, Heyting::Element*);
+    Heyting::Element* quotient(Heyting::Element*, Heyting::Element*);
+    
+public:
+    
+    Saturation(Heyting&);
+    
+    size_t saturate();
+    bool implies(Heyting::Element*, Heyting::Element*) const;
+    
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "service.hpp"
+
+Service::Service(Heyting& h, size_t workers, size_t c, size_t b) : heyting(h), capacity(c == 0 ? 1 : c), batch(b == 0 ? 1 : b), running(0), stopping(false) {
+    if(workers == 0)
+        workers = 1;
+    heyting.setConcurrent(true);
+    for(size_t i = 0;i < workers; ++i) {
+        provers.emplace_back(new Prover(heyting));
+        provers.back()->setVerbose(false);
+    }
+    for(size_t i = 0;i < workers; ++i)
+        threads.emplace_back(&Service::work, this, std::ref(*provers[i]));
+}
+
+Service::~Service() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    for(auto& t : threads)
+        t.join();
+    heyting.setConcurrent(false);
+}
+
+std::future<Prover::Result> Service::submit(Heyting::Element* x, Heyting::Element* y, const Prover::Limits& limits) {
+    auto promise = std::make_shared<std::promise<Prover::Result>>();
+    auto future = promise->get_future();
+    submit(x, y, [promise](Prover::Result result) { promise->set_value(result); }, limits);
+    return future;
+}
+
+void Service::submit(Heyting::Element* x, Heyting::Element* y, Callback callback, const Prover::Limits& limits) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this]() { return queue.size() < capacity; });
+    push(Job{ x, y, limits, std::move(callback) });
+}
+
+bool Service::trySubmit(Heyting::Element* x, Heyting::Element* y, Callback callback, const Prover::Limits& limits) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(queue.size() >= capacity)
+        return false;
+    push(Job{ x, y, limits, std::move(callback) });
+    return true;
+}
+
+// Called with the mutex held
+void Service::push(Job&& job) {
+    queue.push_back(std::move(job));
+    notEmpty.notify_one();
+}
+
+void Service::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return queue.empty() && running == 0; });
+}
+
+size_t Service::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size() + running;
+}
+
+// Takes the goal at the front of the queue, and the goals that can be shown together with it
+// (called with the mutex held, on a queue that is not empty)
+void Service::take(std::vector<Job>& jobs) {
+    jobs.push_back(std::move(queue.front()));
+    queue.pop_front();
+    
+    auto x = jobs.front().x;
+    for(auto i = queue.begin(); i != queue.end() && jobs.size() < batch;) {
+        if(i->x == x) {
+            jobs.push_back(std::move(*i));
+            i = queue.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+    running += jobs.size();
+}
+
+void Service::work(Prover& prover) {
+    std::vector<Job> jobs;
+    
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if(queue.empty())
+                return;
+            take(jobs);
+        }
+        notFull.notify_all();
+        
+        // Every goal is answered as soon as it is shown, and a search that throws answers its goal with GAVE_UP.
+        // A callback that throws has been called already, and must not take the worker (or the other goals) with it
+        for(auto& job : jobs) {
+            Prover::Result result = Prover::GAVE_UP;
+            try {
+                result = prover.implication(job.x, job.y, job.limits);
+            }
+            catch(...) {
+            }
+            if(job.callback) {
+                try {
+                    job.callback(result);
+                }
+                catch(...) {
+                }
+            }
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running -= jobs.size();
+            if(queue.empty() && running == 0)
+                idle.notify_all();
+        }
+        jobs.clear();
+    }
+}
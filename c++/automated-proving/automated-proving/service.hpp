@@ -0,0 +1,88 @@
+#ifndef service_hpp
+#define service_hpp
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include "heyting.hpp"
+#include "prover.hpp"
+
+/*
+ * Answers implications submitted by many threads at once, against one shared Heyting algebra.
+ *
+ * Goals wait in a bounded queue: submit blocks while it is full, and trySubmit refuses them.
+ * A fixed set of workers, each with a prover (and memo) of its own, drains the queue. A worker that takes a goal
+ * also takes the other waiting goals from the same source (the same hypotheses), and shows them one after the other,
+ * so that they find the attempts about that source in the memo of the same prover. Every goal keeps its own limits.
+ *
+ * The workers only add arrows and elements to the algebra, so the other threads may keep using it, except for
+ * the operations that act on all of it at once (contexts, rollback and clearArrows), which need the service idle.
+ */
+class Service {
+
+public:
+    
+    typedef std::function<void(Prover::Result)> Callback;
+    
+private:
+    
+    struct Job {
+        Heyting::Element* x;
+        Heyting::Element* y;
+        Prover::Limits limits;
+        Callback callback;
+    };
+    
+    Heyting& heyting;
+    const size_t capacity;
+    const size_t batch;
+    
+    std::vector<std::unique_ptr<Prover>> provers;
+    std::vector<std::thread> threads;
+    
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull, idle;
+    std::deque<Job> queue;
+    size_t running;
+    bool stopping;
+    
+    Service(const Service&) = delete;
+    Service& operator=(const Service&) = delete;
+    
+    void work(Prover&);
+    void take(std::vector<Job>&);
+    void push(Job&&);
+    
+public:
+    
+    // The number of workers (at least one), the number of goals that can wait, and the most goals shown together
+    Service(Heyting&, size_t, size_t, size_t = 64);
+    
+    // Lets the workers finish all goals that were submitted
+    // (the algebra is locked on every access while the service exists)
+    ~Service();
+    
+    size_t size() const { return threads.size(); }
+    
+    // Waits for room in the queue; the callback is called on a worker thread
+    // (the cancellation flag of the limits, if any, has to outlive the goal)
+    std::future<Prover::Result> submit(Heyting::Element*, Heyting::Element*, const Prover::Limits& = Prover::Limits());
+    void submit(Heyting::Element*, Heyting::Element*, Callback, const Prover::Limits& = Prover::Limits());
+    
+    // Does not wait, and returns false if the queue is full
+    bool trySubmit(Heyting::Element*, Heyting::Element*, Callback, const Prover::Limits& = Prover::Limits());
+    
+    // Waits until all goals submitted so far have been answered
+    void wait();
+    
+    // Goals that are waiting or being shown
+    size_t pending();
+    
+};
+
+#endif
@@ -0,0 +1,384 @@
+#include "solver.hpp"
+#include <algorithm>
+
+static const uint32_t NONE = 0xffffffff;
+
+const uint8_t Solver::UNASSIGNED;
+
+Solver::Solver() : learned(0), propagated(0), consistent(true), increment(1), clauseIncrement(1) {
+}
+
+Solver::Variable Solver::addVariable() {
+    Variable v = (Variable) values.size();
+    values.push_back(UNASSIGNED);
+    levels.push_back(0);
+    reasons.push_back(NONE);
+    phases.push_back(0);
+    activities.push_back(0);
+    positions.push_back(-1);
+    seen.push_back(0);
+    watches.resize(2 * values.size());
+    heapInsert(v);
+    return v;
+}
+
+uint8_t Solver::value(Literal l) const {
+    uint8_t v = values[l >> 1];
+    return v == UNASSIGNED ? UNASSIGNED : (uint8_t) (v ^ (l & 1));
+}
+
+void Solver::assign(Literal l, uint32_t reason) {
+    Variable v = variable(l);
+    values[v] = (uint8_t) !(l & 1);
+    levels[v] = level();
+    reasons[v] = reason;
+    trail.push_back(l);
+}
+
+bool Solver::addClause(std::vector<Literal> clause) {
+    // Clauses are only added between calls to solve, when nothing but the facts of level 0 is assigned
+    if(!consistent)
+        return false;
+    
+    std::sort(clause.begin(), clause.end());
+    clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+    size_t n = 0;
+    for(size_t i = 0;i < clause.size(); ++i) {
+        // Tautologies and clauses that hold already are left out, and so are literals that are false already
+        if((i > 0 && clause[i] == negation(clause[i - 1])) || value(clause[i]) == 1)
+            return true;
+        if(value(clause[i]) == UNASSIGNED)
+            clause[n++] = clause[i];
+    }
+    clause.resize(n);
+    
+    if(clause.empty()) {
+        consistent = false;
+    }
+    else if(clause.size() == 1) {
+        assign(clause[0], NONE);
+        if(propagate() != NONE)
+            consistent = false;
+    }
+    else {
+        attach(clause, false);
+    }
+    return consistent;
+}
+
+uint32_t Solver::attach(const std::vector<Literal>& clause, bool isLearned) {
+    uint32_t c = (uint32_t) clauses.size();
+    clauses.push_back(Clause{ (uint32_t) literals.size(), (uint32_t) clause.size(), isLearned, 0 });
+    literals.insert(literals.end(), clause.begin(), clause.end());
+    watches[clause[0]].push_back(c);
+    watches[clause[1]].push_back(c);
+    if(isLearned)
+        ++learned;
+    return c;
+}
+
+// Returns the clause that became false, if any
+uint32_t Solver::propagate() {
+    while(propagated < trail.size()) {
+        Literal falsified = negation(trail[propagated++]);
+        auto& watching = watches[falsified];
+        size_t i = 0, j = 0;
+        
+        while(i < watching.size()) {
+            uint32_t c = watching[i++];
+            Clause& clause = clauses[c];
+            Literal* l = &literals[clause.start];
+            
+            // Keep the falsified literal second, so that the first one is the one implied
+            if(l[0] == falsified)
+                std::swap(l[0], l[1]);
+            if(value(l[0]) == 1) {
+                watching[j++] = c;
+                continue;
+            }
+            
+            // Look for another literal to watch
+            bool moved = false;
+            for(uint32_t k = 2;k < clause.size; ++k)
+                if(value(l[k]) != 0) {
+                    std::swap(l[1], l[k]);
+                    watches[l[1]].push_back(c);
+                    moved = true;
+                    break;
+                }
+            if(moved)
+                continue;
+            
+            watching[j++] = c;
+            if(value(l[0]) == 0) {
+                while(i < watching.size())
+                    watching[j++] = watching[i++];
+                watching.resize(j);
+                propagated = trail.size();
+                return c;
+            }
+            assign(l[0], c);
+        }
+        watching.resize(j);
+    }
+    return NONE;
+}
+
+// First-UIP learning: resolves the conflict with the reasons of the literals of the current level,
+// until a single one of them is left
+void Solver::analyze(uint32_t conflict, std::vector<Literal>& clause, uint32_t& backtrackLevel) {
+    clause.assign(1, 0);
+    int open = 0;
+    Literal p = NONE;
+    size_t index = trail.size();
+    uint32_t c = conflict;
+    
+    do {
+        Clause& reason = clauses[c];
+        if(reason.learned)
+            bump(reason);
+        for(uint32_t k = (p == NONE ? 0 : 1);k < reason.size; ++k) {
+            Literal q = literals[reason.start + k];
+            Variable v = variable(q);
+            if(seen[v] || levels[v] == 0)
+                continue;
+            seen[v] = 1;
+            bump(v);
+            if(levels[v] >= level())
+                ++open;
+            else
+                clause.push_back(q);
+        }
+        
+        while(!seen[variable(trail[--index])]);
+        p = trail[index];
+        c = reasons[variable(p)];
+        seen[variable(p)] = 0;
+        --open;
+    } while(open > 0);
+    clause[0] = negation(p);
+    
+    // Watch the literal of the highest level besides the asserting one, which is where the search goes back to
+    backtrackLevel = 0;
+    size_t highest = 1;
+    for(size_t i = 1;i < clause.size(); ++i) {
+        seen[variable(clause[i])] = 0;
+        if(levels[variable(clause[i])] > backtrackLevel) {
+            backtrackLevel = levels[variable(clause[i])];
+            highest = i;
+        }
+    }
+    if(clause.size() > 1)
+        std::swap(clause[1], clause[highest]);
+}
+
+void Solver::backtrack(uint32_t target) {
+    if(level() <= target)
+        return;
+    for(size_t i = trail.size();i > limits[target]; --i) {
+        Variable v = variable(trail[i - 1]);
+        phases[v] = values[v];
+        values[v] = UNASSIGNED;
+        reasons[v] = NONE;
+        if(positions[v] < 0)
+            heapInsert(v);
+    }
+    trail.resize(limits[target]);
+    limits.resize(target);
+    propagated = trail.size();
+}
+
+// Drops the less active half of the learned clauses (only at level 0, where no clause is the reason of a literal
+// that analyze looks at)
+void Solver::reduce() {
+    std::vector<double> scores;
+    for(auto& clause : clauses)
+        if(clause.learned && clause.size > 2)
+            scores.push_back(clause.activity);
+    if(scores.empty())
+        return;
+    std::nth_element(scores.begin(), scores.begin() + scores.size() / 2, scores.end());
+    double median = scores[scores.size() / 2];
+    
+    std::vector<Literal> keptLiterals;
+    std::vector<Clause> kept;
+    keptLiterals.reserve(literals.size());
+    for(auto& clause : clauses) {
+        if(clause.learned && clause.size > 2 && clause.activity < median) {
+            --learned;
+            continue;
+        }
+        Clause moved = clause;
+        moved.start = (uint32_t) keptLiterals.size();
+        keptLiterals.insert(keptLiterals.end(), literals.begin() + clause.start, literals.begin() + clause.start + clause.size);
+        kept.push_back(moved);
+    }
+    literals.swap(keptLiterals);
+    clauses.swap(kept);
+    
+    // The watched literals stay in front, so the watches are the same, but for the new positions of the clauses
+    for(auto& watching : watches)
+        watching.clear();
+    for(uint32_t c = 0;c < clauses.size(); ++c) {
+        watches[literals[clauses[c].start]].push_back(c);
+        watches[literals[clauses[c].start + 1]].push_back(c);
+    }
+    for(auto l : trail)
+        reasons[variable(l)] = NONE;
+}
+
+Solver::Result Solver::solve(const std::vector<Literal>& assumptions, uint64_t maxConflicts) {
+    model.clear();
+    if(!consistent)
+        return UNSATISFIABLE;
+    if(propagate() != NONE) {
+        consistent = false;
+        return UNSATISFIABLE;
+    }
+    
+    uint64_t conflicts = 0, sinceRestart = 0, restarts = 0;
+    uint64_t restartLimit = 100 * luby(restarts);
+    std::vector<Literal> clause;
+    
+    while(true) {
+        uint32_t conflict = propagate();
+        if(conflict != NONE) {
+            ++conflicts;
+            ++sinceRestart;
+            if(level() == 0) {
+                consistent = false;
+                return UNSATISFIABLE;
+            }
+            
+            uint32_t target;
+            analyze(conflict, clause, target);
+            backtrack(target);
+            if(clause.size() == 1)
+                assign(clause[0], NONE);
+            else
+                assign(clause[0], attach(clause, true));
+            increment /= 0.95;
+            clauseIncrement /= 0.999;
+            continue;
+        }
+        
+        if(maxConflicts != 0 && conflicts >= maxConflicts) {
+            backtrack(0);
+            return UNKNOWN;
+        }
+        if(sinceRestart >= restartLimit) {
+            backtrack(0);
+            sinceRestart = 0;
+            restartLimit = 100 * luby(++restarts);
+            if(learned > 2000 + clauses.size() / 2)
+                reduce();
+        }
+        
+        // The assumptions are the first decisions, one level each (a level of its own also if it holds already)
+        Literal next;
+        if(level() < assumptions.size()) {
+            next = assumptions[level()];
+            if(value(next) == 0) {
+                backtrack(0);
+                return UNSATISFIABLE;
+            }
+            if(value(next) == 1) {
+                limits.push_back(trail.size());
+                continue;
+            }
+        }
+        else {
+            Variable v = 0;
+            do {
+                if(heap.empty()) {
+                    model = values;
+                    backtrack(0);
+                    return SATISFIABLE;
+                }
+                v = heapPop();
+            } while(values[v] != UNASSIGNED);
+            next = literal(v, phases[v] == 0);
+        }
+        limits.push_back(trail.size());
+        assign(next, NONE);
+    }
+}
+
+void Solver::bump(Variable v) {
+    activities[v] += increment;
+    if(activities[v] > 1e100) {
+        for(auto& a : activities)
+            a *= 1e-100;
+        increment *= 1e-100;
+    }
+    if(positions[v] >= 0)
+        heapUp((size_t) positions[v]);
+}
+
+void Solver::bump(Clause& clause) {
+    clause.activity += clauseIncrement;
+    if(clause.activity > 1e20) {
+        for(auto& c : clauses)
+            c.activity *= 1e-20;
+        clauseIncrement *= 1e-20;
+    }
+}
+
+void Solver::heapUp(size_t i) {
+    Variable v = heap[i];
+    while(i > 0 && activities[heap[(i - 1) / 2]] < activities[v]) {
+        heap[i] = heap[(i - 1) / 2];
+        positions[heap[i]] = (int64_t) i;
+        i = (i - 1) / 2;
+    }
+    heap[i] = v;
+    positions[v] = (int64_t) i;
+}
+
+void Solver::heapDown(size_t i) {
+    Variable v = heap[i];
+    while(2 * i + 1 < heap.size()) {
+        size_t child = 2 * i + 1;
+        if(child + 1 < heap.size() && activities[heap[child + 1]] > activities[heap[child]])
+            ++child;
+        if(activities[heap[child]] <= activities[v])
+            break;
+        heap[i] = heap[child];
+        positions[heap[i]] = (int64_t) i;
+        i = child;
+    }
+    heap[i] = v;
+    positions[v] = (int64_t) i;
+}
+
+void Solver::heapInsert(Variable v) {
+    heap.push_back(v);
+    heapUp(heap.size() - 1);
+}
+
+Solver::Variable Solver::heapPop() {
+    Variable v = heap.front();
+    positions[v] = -1;
+    heap.front() = heap.back();
+    heap.pop_back();
+    if(!heap.empty()) {
+        positions[heap.front()] = 0;
+        heapDown(0);
+    }
+    return v;
+}
+
+// The Luby sequence 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, ... (the i-th term, from 0)
+uint64_t Solver::luby(uint64_t i) {
+    uint64_t size = 1, exponent = 0;
+    while(size < i + 1) {
+        ++exponent;
+        size = 2 * size + 1;
+    }
+    while(size - 1 != i) {
+        size = (size - 1) >> 1;
+        --exponent;
+        i = i % size;
+    }
+    return (uint64_t) 1 << exponent;
+}
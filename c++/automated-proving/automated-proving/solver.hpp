@@ -0,0 +1,103 @@
+#ifndef solver_hpp
+#define solver_hpp
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * A small CDCL SAT solver: two watched literals, first-UIP clause learning, VSIDS with phase saving, and Luby restarts.
+ *
+ * Clauses can be added between calls to solve, which keeps the clauses it learned, as they follow from the clauses
+ * alone. Assumptions hold for a single call only, so many queries can be asked against the same clauses.
+ * A literal is 2 * variable for the variable itself, and 2 * variable + 1 for its negation.
+ */
+class Solver {
+
+public:
+    
+    typedef uint32_t Variable;
+    typedef uint32_t Literal;
+    
+    enum Result { SATISFIABLE, UNSATISFIABLE, UNKNOWN };
+    
+    static Literal literal(Variable v, bool negative = false) { return 2 * v + (negative ? 1 : 0); }
+    static Literal negation(Literal l) { return l ^ 1; }
+    static Variable variable(Literal l) { return l >> 1; }
+    
+private:
+    
+    // The literals of all clauses, one after the other, with the two watched literals of every clause in front
+    struct Clause {
+        uint32_t start;
+        uint32_t size;
+        bool learned;
+        double activity;
+    };
+    std::vector<Literal> literals;
+    std::vector<Clause> clauses;
+    size_t learned;
+    
+    // The clauses watching every literal (watches[l] are looked at when l becomes false)
+    std::vector<std::vector<uint32_t>> watches;
+    
+    // Per variable: value (0 false, 1 true, 2 unassigned), decision level, the clause that implied it, and the saved phase
+    static const uint8_t UNASSIGNED = 2;
+    std::vector<uint8_t> values;
+    std::vector<uint32_t> levels;
+    std::vector<uint32_t> reasons;
+    std::vector<uint8_t> phases;
+    
+    std::vector<Literal> trail;
+    std::vector<size_t> limits;     // Start of every decision level in the trail
+    size_t propagated;
+    bool consistent;                // False once the clauses themselves are known to be unsatisfiable
+    
+    // VSIDS: a binary max-heap of the unassigned variables by activity
+    std::vector<double> activities;
+    double increment, clauseIncrement;
+    std::vector<Variable> heap;
+    std::vector<int64_t> positions;     // Position of every variable in the heap, -1 if it is not in it
+    
+    std::vector<uint8_t> seen;
+    std::vector<uint8_t> model;
+    
+    uint8_t value(Literal l) const;
+    uint32_t level() const { return (uint32_t) limits.size(); }
+    
+    void assign(Literal, uint32_t);
+    uint32_t propagate();
+    void analyze(uint32_t, std::vector<Literal>&, uint32_t&);
+    void backtrack(uint32_t);
+    uint32_t attach(const std::vector<Literal>&, bool);
+    void reduce();
+    
+    void bump(Variable);
+    void bump(Clause&);
+    void heapUp(size_t);
+    void heapDown(size_t);
+    void heapInsert(Variable);
+    Variable heapPop();
+    
+    static uint64_t luby(uint64_t);
+    
+public:
+    
+    Solver();
+    
+    size_t size() const { return values.size(); }
+    
+    Variable addVariable();
+    
+    // Returns false if the clauses are unsatisfiable already
+    bool addClause(std::vector<Literal>);
+    
+    // Gives up with UNKNOWN after the given number of conflicts (0 for no limit)
+    Result solve(const std::vector<Literal>& = std::vector<Literal>(), uint64_t = 0);
+    
+    // The value of a variable in the model found by the last call to solve that returned SATISFIABLE
+    bool modelValue(Variable v) const { return model[v] == 1; }
+    
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef span_hpp
+#define span_hpp
+
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+
+/*
+ * An immutable view of a sorted array that is stored elsewhere (the factors of products and coproducts live in the arena).
+ * Copying a span copies the view, never the entries.
+ */
+template<class T>
+class Span {
+
+    const T* first;
+    size_t count;
+    
+public:
+    
+    typedef T value_type;
+    typedef const T* iterator;
+    
+    Span() : first(nullptr), count(0) {}
+    Span(const T* f, size_t n) : first(f), count(n) {}
+    
+    iterator begin() const { return first; }
+    iterator end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T operator[](size_t i) const { return first[i]; }
+    
+    bool contains(T x) const {
+        return std::binary_search(first, first + count, x, std::less<T>());
+    }
+    
+    // Whether a container holds the same entries, in the same order
+    template<class C>
+    bool equals(const C& c) const {
+        return c.size() == count && std::equal(first, first + count, c.begin());
+    }
+    
+};
+
+#endif
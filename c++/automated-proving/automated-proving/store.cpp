@@ -0,0 +1,231 @@
+#include "store.hpp"
+#include "hashset.hpp"
+#include "mappedfile.hpp"
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+static const char magic[8] = { 'H', 'E', 'Y', 'T', 'I', 'N', 'G', 0 };
+
+void Store::save(Heyting& h, const std::string& path) {
+    Heyting::Lock lock(h, false);
+    
+    std::vector<Record> records;
+    std::vector<uint32_t> factors, adjacency;
+    std::string names;
+    records.reserve(h.elements.size());
+    
+    for(auto x : h.elements) {
+        Record r = { (uint32_t) x->type, 0, 0 };
+        switch(x->type) {
+            case Heyting::Element::ELEMENT: {
+                auto pos = h.names.find(x->id);
+                r.length = UNNAMED;
+                if(pos != h.names.end()) {
+                    r.offset = names.size();
+                    r.length = (uint32_t) pos->second.size();
+                    names += pos->second;
+                }
+                break;
+            }
+            
+            case Heyting::Element::PRODUCT:
+            case Heyting::Element::COPRODUCT: {
+                auto& f = (x->type == Heyting::Element::PRODUCT) ? ((Heyting::Product*) x)->factors : ((Heyting::Coproduct*) x)->factors;
+                r.offset = factors.size();
+                r.length = (uint32_t) f.size();
+                for(auto y : f)
+                    factors.push_back(y->id);
+                break;
+            }
+            
+            case Heyting::Element::EXPONENTIAL: {
+                auto exp = (Heyting::Exponential*) x;
+                r.offset = exp->base->id;
+                r.length = exp->exponent->id;
+                break;
+            }
+        }
+        records.push_back(r);
+        
+        adjacency.push_back((uint32_t) x->arrowsTo.size());
+        adjacency.push_back((uint32_t) x->arrowsFrom.size());
+        for(auto y : x->arrowsTo)
+            adjacency.push_back(y->id);
+        for(auto y : x->arrowsFrom)
+            adjacency.push_back(y->id);
+    }
+    
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = VERSION;
+    header.order = ORDER;
+    header.elements = records.size();
+    header.factors = factors.size();
+    header.adjacency = adjacency.size();
+    header.names = names.size();
+    
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char*) &header, sizeof(header));
+    out.write((const char*) records.data(), records.size() * sizeof(Record));
+    out.write((const char*) factors.data(), factors.size() * sizeof(uint32_t));
+    out.write((const char*) adjacency.data(), adjacency.size() * sizeof(uint32_t));
+    out.write(names.data(), names.size());
+    out.close();
+    if(!out)
+        throw std::runtime_error(path + ": cannot write image");
+}
+
+void Store::load(Heyting& h, const std::string& path) {
+    MappedFile file(path);
+    try {
+        load(h, file.begin(), file.end());
+    }
+    catch(const std::runtime_error& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+}
+
+void Store::load(Heyting& h, const char* begin, const char* end) {
+    Heyting::Lock lock(h, true);
+    if(h.elements.size() != 2 || !h.frames.empty())
+        throw std::runtime_error("an image can only be loaded into an empty algebra");
+    
+    // Check the header, and that the sections fit in the image
+    Header header;
+    size_t length = (size_t) (end - begin);
+    if(length < sizeof(Header))
+        throw std::runtime_error("truncated image");
+    std::memcpy(&header, begin, sizeof(Header));
+    if(std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+        throw std::runtime_error("not an image");
+    if(header.order != ORDER)
+        throw std::runtime_error("image has a different byte order");
+    if(header.version != VERSION)
+        throw std::runtime_error("image has version " + std::to_string(header.version) + " instead of " + std::to_string(VERSION));
+    
+    size_t left = length - sizeof(Header);
+    if(header.elements < 2 || header.elements > left / sizeof(Record) || header.elements >= UNNAMED)
+        throw std::runtime_error("truncated image");
+    left -= header.elements * sizeof(Record);
+    if(header.factors > left / sizeof(uint32_t))
+        throw std::runtime_error("truncated image");
+    left -= header.factors * sizeof(uint32_t);
+    if(header.adjacency > left / sizeof(uint32_t))
+        throw std::runtime_error("truncated image");
+    left -= header.adjacency * sizeof(uint32_t);
+    if(header.names != left)
+        throw std::runtime_error("truncated image");
+    
+    // The sections are read in place (a mapped image is aligned to a page, and all sections to their integers)
+    auto records = (const Record*) (begin + sizeof(Header));
+    auto factors = (const uint32_t*) (records + header.elements);
+    auto adjacency = (const uint32_t*) (factors + header.factors);
+    auto names = (const char*) (adjacency + header.adjacency);
+    if(records[0].type != Heyting::Element::ELEMENT || records[1].type != Heyting::Element::ELEMENT)
+        throw std::runtime_error("image does not start with True and False");
+    
+    auto bad = [](size_t i) {
+        return std::runtime_error("invalid element " + std::to_string(i));
+    };
+    
+    // The elements, which only refer to elements before them (True and False are there already)
+    h.elements.reserve(header.elements);
+    h.products.reserve(header.elements);
+    h.coproducts.reserve(header.elements);
+    h.exponentials.reserve(header.elements);
+    for(size_t i = 2;i < header.elements; ++i) {
+        const Record& r = records[i];
+        switch(r.type) {
+            case Heyting::Element::ELEMENT: {
+                if(r.length == UNNAMED)
+                    h.createElement();
+                else if(r.offset <= header.names && r.length <= header.names - r.offset)
+                    h.createElement(std::string(names + r.offset, r.length));
+                else
+                    throw bad(i);
+                break;
+            }
+            
+            case Heyting::Element::PRODUCT:
+            case Heyting::Element::COPRODUCT: {
+                if(r.offset > header.factors || r.length > header.factors - r.offset || r.length < 2)
+                    throw bad(i);
+                // The image was interned when it was saved, so the factors can be taken as they are
+                // (they only have to be sorted again, as they are sorted by address)
+                auto first = (Heyting::Element**) h.arena.allocate(r.length * sizeof(Heyting::Element*), alignof(Heyting::Element*));
+                for(size_t k = 0;k < r.length; ++k) {
+                    if(factors[r.offset + k] >= i)
+                        throw bad(i);
+                    first[k] = h.elements[factors[r.offset + k]];
+                }
+                std::sort(first, first + r.length, std::less<Heyting::Element*>());
+                if(std::adjacent_find(first, first + r.length) != first + r.length)
+                    throw bad(i);
+                Span<Heyting::Element*> f(first, r.length);
+                
+                size_t hash = hash_set{}(f);
+                if(r.type == Heyting::Element::PRODUCT) {
+                    auto without = (std::atomic<Heyting::Element*>*) h.arena.allocate(r.length * sizeof(std::atomic<Heyting::Element*>), alignof(std::atomic<Heyting::Element*>));
+                    for(size_t k = 0;k < r.length; ++k)
+                        new (&without[k]) std::atomic<Heyting::Element*>(nullptr);
+                    auto prod = h.arena.create<Heyting::Product>((Heyting::Id) i, f, without);
+                    h.registerElement(prod);
+                    h.products.emplace(hash, prod);
+                }
+                else {
+                    auto coprod = h.arena.create<Heyting::Coproduct>((Heyting::Id) i, f);
+                    h.registerElement(coprod);
+                    h.coproducts.emplace(hash, coprod);
+                }
+                break;
+            }
+            
+            case Heyting::Element::EXPONENTIAL: {
+                if(r.offset >= i || r.length >= i)
+                    throw bad(i);
+                auto b = h.elements[r.offset], e = h.elements[r.length];
+                auto exp = h.arena.create<Heyting::Exponential>((Heyting::Id) i, b, e);
+                h.registerElement(exp);
+                h.exponentials.emplace(std::pair<Heyting::Id, Heyting::Id>(b->id, e->id), exp);
+                break;
+            }
+            
+            default:
+                throw bad(i);
+        }
+    }
+    
+    // Then all arrows, replacing the structural ones added above, so that every adjacency has its saved order
+    // (Adjacency::assign takes the entries as they are, so ids out of range and repeated ids are refused here,
+    // the latter by marking every id with the number of the list it was last seen in)
+    std::vector<Heyting::Element*> list;
+    std::vector<uint64_t> seen(header.elements, 0);
+    uint64_t lists = 0;
+    size_t k = 0;
+    auto fill = [&](Adjacency<Heyting::Element*>& side, uint32_t n, size_t i) {
+        list.resize(n);
+        ++lists;
+        for(uint32_t j = 0;j < n; ++j, ++k) {
+            if(adjacency[k] >= header.elements || seen[adjacency[k]] == lists)
+                throw bad(i);
+            seen[adjacency[k]] = lists;
+            list[j] = h.elements[adjacency[k]];
+        }
+        side.assign(list.data(), n);
+    };
+    for(size_t i = 0;i < header.elements; ++i) {
+        if(header.adjacency - k < 2 || header.adjacency - k - 2 < (uint64_t) adjacency[k] + adjacency[k + 1])
+            throw bad(i);
+        uint32_t to = adjacency[k], from = adjacency[k + 1];
+        k += 2;
+        fill(h.elements[i]->arrowsTo, to, i);
+        fill(h.elements[i]->arrowsFrom, from, i);
+    }
+    
+    ++h.currentVersion;
+    if(h.indexed)
+        h.indexReachability(true);
+}
@@ -0,0 +1,56 @@
+#ifndef store_hpp
+#define store_hpp
+
+#include <string>
+#include <cstdint>
+#include "heyting.hpp"
+
+/*
+ * A binary snapshot of a Heyting algebra: all elements (with their kind, operands and names) and all arrows,
+ * in the order in which they were added, so that a loaded algebra behaves exactly like the saved one.
+ *
+ * The image consists of fixed-size sections of native integers, which are read straight from the mapped file
+ * without any parsing. The elements themselves are rebuilt in the arena of the algebra (they hold pointers, so
+ * they cannot live in the image), but without the lookups of interning, as the saved algebra was interned already:
+ *
+ *   header        magic, version, byte order, and the lengths of the sections below
+ *   records       per element: kind, and the offset and length of its operands (or its base and exponent ids)
+ *   factors       ids of the factors of all products and coproducts
+ *   adjacency     per element: the number of arrows to and from it, followed by their ids in insertion order
+ *   names         the names of the plain elements, one after the other
+ */
+class Store {
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t order;     // Written as ORDER, to detect an image from a machine with a different byte order
+        uint64_t elements;
+        uint64_t factors;
+        uint64_t adjacency;
+        uint64_t names;
+    };
+    
+    struct Record {
+        uint32_t type;
+        uint32_t length;    // Number of factors, length of the name (UNNAMED if there is none), or the exponent id
+        uint64_t offset;    // Offset of the factors or the name, or the base id
+    };
+    
+    static const uint32_t VERSION = 1;
+    static const uint32_t ORDER = 0x01020304;
+    static const uint32_t UNNAMED = 0xffffffff;
+    
+public:
+    
+    // Both throw std::runtime_error if the file cannot be written or read, or is not a valid image
+    static void save(Heyting&, const std::string&);
+    static void load(Heyting&, const std::string&);
+    
+    // Loads an image that is already in memory, into an algebra that has no elements besides True and False yet
+    // (if the image turns out to be invalid halfway, the elements before that point remain)
+    static void load(Heyting&, const char*, const char*);
+    
+};
+
+#endif
@@ -1,9 +1,10 @@
 #include "tests.hpp"
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 void Tests::run() {
-    std::vector<bool (*)(void)> tests = { &test_1, &test_2, &test_3, &test_4, &test_5, &test_6, &test_7, &test_8, &test_9 };
+    std::vector<bool (*)(void)> tests = { &test_1, &test_2, &test_3, &test_4, &test_5, &test_6, &test_7, &test_8, &test_9, &test_10, &test_11, &test_12, &test_13, &test_14, &test_15, &test_16, &test_17, &test_18, &test_19, &test_20, &test_21, &test_22, &test_23, &test_24, &test_25, &test_26, &test_27, &test_28, &test_29, &test_30, &test_31, &test_32, &test_33, &test_34, &test_35, &test_36, &test_37 };
     size_t total = tests.size();
     size_t succeeded = 0;
     
@@ -89,6 +90,18 @@ bool Tests::test_3() {
 
 // ----------------------------------------------------------------
 #include "prover.hpp"
+#include "saturation.hpp"
+#include "parser.hpp"
+#include "store.hpp"
+#include "service.hpp"
+#include "solver.hpp"
+#include "countermodels.hpp"
+#include <stdexcept>
+#include <cstdio>
+#include <random>
+#include <fstream>
+#include <cstring>
+#include <iterator>
 
 bool Tests::test_4() {
     /*
@@ -322,3 +335,1330 @@ bool Tests::test_9() {
     
     return flag;
 }
+
+bool Tests::test_10() {
+    /*
+     * Check that the reachability index agrees with the search in isArrow
+     */
+    Heyting h;
+    h.indexReachability(true);
+    
+    auto P = h.createElement("P");
+    auto Q = h.createElement("Q");
+    auto R = h.createElement("R");
+    auto S = h.createElement("S");
+    
+    h.putArrow(P, Q);
+    h.putArrow(h.product({ Q, R }), S);
+    h.putArrow(h.True, h.coproduct({ P, R }));
+    h.putArrow(h.negate(S), h.False);
+    h.putArrow(S, P);
+    
+    // Compare the answers of the (incrementally updated) index with the answers of the search
+    auto compare = [&h]() {
+        std::vector<bool> answers;
+        for(size_t i = 0;i < h.size(); ++i)
+            for(size_t j = 0;j < h.size(); ++j)
+                answers.push_back(h.isArrow(h.element((Heyting::Id) i), h.element((Heyting::Id) j)));
+        
+        h.indexReachability(false);
+        bool flag = true;
+        size_t k = 0;
+        for(size_t i = 0;i < h.size(); ++i)
+            for(size_t j = 0;j < h.size(); ++j)
+                flag &= (answers[k++] == h.isArrow(h.element((Heyting::Id) i), h.element((Heyting::Id) j)));
+        h.indexReachability(true);
+        return flag;
+    };
+    
+    bool flag = compare();
+    
+    auto T = h.createElement("T");
+    h.putArrow(R, T);
+    h.putArrow(h.exponential(T, Q), h.coproduct({ Q, T }));
+    flag &= compare();
+    
+    h.clearArrows();
+    h.putArrow(Q, R);
+    h.putArrow(h.product({ P, T }), h.False);
+    flag &= compare();
+    
+    return flag;
+}
+
+bool Tests::test_11() {
+    /*
+     * Check long chains of implications, in both search orders
+     */
+    Heyting h;
+    
+    std::vector<Heyting::Element*> chain;
+    for(int i = 0;i < 100000; ++i) {
+        chain.push_back(h.createElement());
+        if(i > 0)
+            h.putArrow(chain[i - 1], chain[i]);
+    }
+    
+    bool flag = h.isArrow(chain.front(), chain.back()) && !h.isArrow(chain.back(), chain.front());
+    h.setSearchOrder(Heyting::BREADTH_FIRST);
+    flag &= h.isArrow(chain.front(), chain.back()) && !h.isArrow(chain.back(), chain.front());
+    return flag;
+}
+
+bool Tests::test_12() {
+    /*
+     * Check that failed attempts are kept for the next query, and forgotten once new hypotheses are added
+     *
+     * Prove:
+     *  (P ^ Q) => R fails at first, and fails again from the memo without expanding as many nodes
+     *  (P ^ Q) => R after adding P => (Q => R)
+     */
+    Heyting h;
+    
+    auto P = h.createElement("P");
+    auto Q = h.createElement("Q");
+    auto R = h.createElement("R");
+    auto P_and_Q = h.product({ P, Q });
+    
+    Prover prover(h);
+    prover.setVerbose(false);
+    Prover::Stats first, second;
+    bool flag = !prover.implication(P_and_Q, R, first) && !prover.implication(P_and_Q, R, second);
+    if(PROVER_STATS) {
+        uint64_t before = 0, after = 0;
+        for(auto n : first.nodes)
+            before += n;
+        for(auto n : second.nodes)
+            after += n;
+        flag &= (before > 0) && (after < before) && (second.memoHits > 0);
+    }
+    
+    h.putArrow(P, h.exponential(R, Q));
+    flag &= prover.implication(P_and_Q, R);
+    return flag;
+}
+
+bool Tests::test_13() {
+    /*
+     * Prove in parallel:
+     *  P ^ (Q v R) = (P ^ Q) v (P ^ R)
+     *  (R => P) => (R => S), given P => Q and Q => S
+     *
+     * and check that Q => P is not shown, and that another prover that stops proving in parallel
+     * leaves the algebra locked for the first one
+     */
+    Heyting h;
+    
+    auto P = h.createElement("P");
+    auto Q = h.createElement("Q");
+    auto R = h.createElement("R");
+    auto S = h.createElement("S");
+    
+    auto LHS = h.product({ P, h.coproduct({ Q, R }) });
+    auto RHS = h.coproduct({ h.product({ P, Q }), h.product({ P, R }) });
+    
+    Prover prover(h);
+    prover.setThreads(4);
+    bool flag = prover.implication(LHS, RHS) && prover.implication(RHS, LHS);
+    
+    h.putArrow(P, Q);
+    h.putArrow(Q, S);
+    flag &= prover.implication(h.exponential(P, R), h.exponential(S, R));
+    flag &= !prover.implication(Q, P);
+    
+    {
+        Prover other(h);
+        other.setThreads(1);
+        flag &= h.isConcurrent();
+        other.setThreads(2);
+        other.setThreads(1);
+        flag &= h.isConcurrent() && !other.implication(Q, P);
+        other.setThreads(2);
+    }
+    flag &= h.isConcurrent();
+    prover.setThreads(1);
+    flag &= !h.isConcurrent();
+    return flag;
+}
+
+bool Tests::test_14() {
+    /*
+     * Check that the search statistics add up, sequentially and in parallel, while proving
+     *  (P ^ Q) => R, given P => (Q => R)
+     */
+    if(!PROVER_STATS)
+        return true;
+    
+    bool flag = true;
+    for(size_t threads : { 1, 4 }) {
+        Heyting h;
+        
+        auto P = h.createElement("P");
+        auto Q = h.createElement("Q");
+        auto R = h.createElement("R");
+        h.putArrow(P, h.exponential(R, Q));
+        
+        Prover prover(h);
+        prover.setThreads(threads);
+        Prover::Stats stats;
+        flag &= prover.implication(h.product({ P, Q }), R, stats);
+        
+        uint64_t nodes = 0, attempts = 0, successes = 0;
+        for(auto n : stats.nodes)
+            nodes += n;
+        for(int r = 0;r < Prover::Stats::RULES; ++r) {
+            flag &= stats.successes[r] <= stats.attempts[r];
+            attempts += stats.attempts[r];
+            successes += stats.successes[r];
+        }
+        flag &= nodes > 0 && nodes == stats.memoMisses;
+        flag &= successes > 0 && attempts >= nodes;
+        flag &= stats.successes[Prover::Stats::PRODUCT_SOURCE] > 0 && stats.arrowsAdded > 0;
+        flag &= stats.isArrowCalls > 0;
+        
+        std::ostringstream dump;
+        stats.dump(dump);
+        flag &= dump.str().find("\"product_source\":{\"attempts\":") != std::string::npos;
+    }
+    return flag;
+}
+
+bool Tests::test_15() {
+    /*
+     * Given (a_i ^ c) => a_i+1 for i = 0, ..., 4
+     *
+     * Prove:
+     *  (a_0 ^ c) => a_5, which needs more pay than the default schedule offers
+     */
+    // Default schedule, up to pay 6, and a schedule that skips ahead (rounds needed in each case)
+    const uint64_t rounds[] = { 3, 5, 2 };
+    bool flag = true;
+    for(int attempt = 0;attempt < 3; ++attempt) {
+        Heyting h;
+        
+        auto c = h.createElement("c");
+        std::vector<Heyting::Element*> a;
+        for(int i = 0;i <= 5; ++i)
+            a.push_back(h.createElement("a" + std::to_string(i)));
+        for(int i = 0;i < 5; ++i)
+            h.putArrow(h.product({ a[i], c }), a[i + 1]);
+        
+        Prover prover(h);
+        if(attempt == 1)
+            prover.setMaxPay(6);
+        if(attempt == 2)
+            prover.setPaySchedule({ 1, 4 });
+        
+        Prover::Stats stats;
+        bool shown = prover.implication(h.product({ a[0], c }), a[5], stats);
+        flag &= (shown == (attempt > 0));
+        if(PROVER_STATS)
+            flag &= (stats.rounds == rounds[attempt]);
+    }
+    return flag;
+}
+
+bool Tests::test_16() {
+    /*
+     * Check that fingerprints, depth and size only depend on the structure of a formula,
+     * by building the same formulas in two Heyting algebras in a different order
+     */
+    Heyting h1, h2;
+    
+    auto P1 = h1.createElement("P");
+    auto Q1 = h1.createElement("Q");
+    auto R1 = h1.createElement("R");
+    auto x1 = h1.exponential(h1.coproduct({ P1, h1.negate(Q1) }), h1.product({ Q1, R1 }));
+    
+    auto R2 = h2.createElement("R");
+    auto Q2 = h2.createElement("Q");
+    h2.createElement("S");
+    auto P2 = h2.createElement("P");
+    auto x2 = h2.exponential(h2.coproduct({ h2.negate(Q2), P2 }), h2.product({ R2, Q2 }));
+    
+    bool flag = (x1->fingerprint == x2->fingerprint) && (x1->depth == 3) && (x2->depth == 3) && (x1->size == 9) && (x2->size == 9);
+    flag &= (P1->fingerprint == P2->fingerprint) && (P1->fingerprint != Q1->fingerprint);
+    flag &= (h1.product({ P1, Q1 })->fingerprint != h1.coproduct({ P1, Q1 })->fingerprint);
+    flag &= (h1.exponential(P1, Q1)->fingerprint != h1.exponential(Q1, P1)->fingerprint);
+    
+    // Printing is linear in the size of the formula, also for deeply nested ones
+    Heyting::Element* deep = P1;
+    for(int i = 0;i < 2000; ++i)
+        deep = h1.product({ h1.coproduct({ deep, Q1 }), R1 });
+    std::string s = h1.to_string(deep);
+    flag &= (deep->depth == 4000) && (s.size() == 2000 * 12 - 1);
+    return flag;
+}
+
+bool Tests::test_17() {
+    /*
+     * Prove in a single batch, sequentially and in parallel:
+     *  True => S, given True => (P v ~R), ~R => S and True => ~P
+     *  True => (U ^ V), given T => U, T => V and True => T
+     *  (A ^ (A => B)) => B
+     *  A => (B => A)
+     *
+     * and check that B => A and True => ~S are not shown
+     */
+    bool flag = true;
+    for(size_t threads : { 1, 4 }) {
+        Heyting h;
+        
+        auto P = h.createElement("P");
+        auto R = h.createElement("R");
+        auto S = h.createElement("S");
+        auto T = h.createElement("T");
+        auto U = h.createElement("U");
+        auto V = h.createElement("V");
+        auto A = h.createElement("A");
+        auto B = h.createElement("B");
+        
+        h.putArrow(h.True, h.coproduct({ P, h.negate(R) }));
+        h.putArrow(h.negate(R), S);
+        h.putArrow(h.True, h.negate(P));
+        h.putArrow(T, U);
+        h.putArrow(T, V);
+        h.putArrow(h.True, T);
+        
+        std::vector<Prover::Goal> goals = {
+            { h.True, S },
+            { h.True, h.product({ U, V }) },
+            { B, A },
+            { h.product({ A, h.exponential(B, A) }), B },
+            { A, h.exponential(A, B) },
+            { h.True, h.negate(S) }
+        };
+        
+        Prover prover(h);
+        prover.setThreads(threads);
+        flag &= (prover.implications(goals) == std::vector<bool> { true, true, false, true, true, false });
+    }
+    return flag;
+}
+
+bool Tests::test_18() {
+    /*
+     * Saturate:
+     *  True => (P v ~R), ~R => S and True => ~P, which gives True => S
+     *  (P ^ Q) => R, which gives P => (Q => R)
+     *
+     * and check that isArrow agrees with the saturation everywhere, also after adding T => P and S => T
+     */
+    Heyting h;
+    
+    auto P = h.createElement("P");
+    auto Q = h.createElement("Q");
+    auto R = h.createElement("R");
+    auto S = h.createElement("S");
+    auto T = h.createElement("T");
+    
+    h.putArrow(h.True, h.coproduct({ P, h.negate(R) }));
+    h.putArrow(h.negate(R), S);
+    h.putArrow(h.True, h.negate(P));
+    h.putArrow(h.product({ P, Q }), R);
+    auto Q_to_R = h.exponential(R, Q);
+    
+    Saturation saturation(h);
+    auto agrees = [&h, &saturation]() {
+        bool flag = true;
+        for(size_t i = 0;i < h.size(); ++i)
+            for(size_t j = 0;j < h.size(); ++j)
+                flag &= (saturation.implies(h.element((Heyting::Id) i), h.element((Heyting::Id) j)) == h.isArrow(h.element((Heyting::Id) i), h.element((Heyting::Id) j)));
+        return flag;
+    };
+    
+    saturation.saturate();
+    bool flag = h.isArrow(h.True, S) && h.isArrow(P, Q_to_R) && !h.isArrow(Q, P) && !h.isArrow(h.True, R) && agrees();
+    
+    // Incrementally: T => P and S => T make everything inconsistent, as True => ~P
+    h.putArrow(T, P);
+    h.putArrow(S, T);
+    auto Q_and_T = h.product({ Q, T });
+    saturation.saturate();
+    flag &= h.isArrow(Q_and_T, R) && h.isArrow(h.True, h.False) && h.isArrow(Q, P) && agrees();
+    return flag;
+}
+
+bool Tests::test_19() {
+    /*
+     * Prove under hypotheses and roll them back again, instead of clearing all arrows:
+     *  P => Q and Q => R give P => R, and afterwards P => R no longer holds, but P ^ Q => P still does
+     * Also with the reachability index, nested snapshots, and a snapshot that has been invalidated by clearArrows
+     */
+    Heyting h;
+    Prover prover(h);
+    
+    auto P = h.createElement("P");
+    auto Q = h.createElement("Q");
+    auto R = h.createElement("R");
+    auto P_and_Q = h.product({ P, Q });
+    
+    auto s1 = h.snapshot();
+    h.putArrow(P, Q);
+    auto s2 = h.snapshot();
+    h.putArrow(Q, R);
+    bool flag = prover.implication(P, R) && h.isArrow(P, R);
+    
+    flag &= h.rollback(s2);
+    flag &= !prover.implication(P, R) && prover.implication(P, Q) && prover.implication(P_and_Q, P);
+    
+    // Elements created after the snapshot remain, with their structural arrows
+    h.indexReachability(true);
+    auto Q_and_R = h.product({ Q, R });
+    h.putArrow(R, P);
+    flag &= prover.implication(R, Q) && h.isArrow(Q_and_R, R);
+    flag &= h.rollback(s1);
+    flag &= !h.isArrow(R, Q) && !prover.implication(P, Q) && h.isArrow(Q_and_R, R) && h.isArrow(P_and_Q, Q);
+    
+    // The log has been rolled back past s2, and clearArrows discards it
+    flag &= !h.rollback(s2);
+    auto s3 = h.snapshot();
+    h.clearArrows();
+    flag &= !h.rollback(s3);
+    return flag;
+}
+
+bool Tests::test_20() {
+    /*
+     * Open many short-lived child contexts on top of P => Q, each with an element R_i of its own and R_i => P,
+     * and check that nothing of a child remains in the parent once it has been dropped
+     */
+    Heyting h;
+    Prover prover(h);
+    
+    auto P = h.createElement("P");
+    auto Q = h.createElement("Q");
+    auto P_and_Q = h.product({ P, Q });
+    h.putArrow(P, Q);
+    size_t n = h.size();
+    
+    bool flag = true;
+    for(int i = 0;i < 1000; ++i) {
+        Heyting::Context context(h);
+        auto R = h.createElement("R" + std::to_string(i));
+        auto R_and_Q = h.product({ R, Q });
+        h.putArrow(R, P);
+        flag &= h.isArrow(R, Q) && h.isArrow(R_and_Q, P) && (h.product({ P, Q }) == P_and_Q);
+        
+        // A nested context sees the elements and arrows of both
+        if(i % 100 == 0) {
+            Heyting::Context nested(h);
+            h.putArrow(Q, R);
+            flag &= prover.implication(Q, P_and_Q) && (h.contexts() == 2);
+        }
+        flag &= !h.isArrow(Q, R) && !prover.implication(Q, P_and_Q);
+    }
+    
+    // The parent is exactly as it was: the same elements and arrows, and the products of the children are gone
+    flag &= (h.size() == n) && (h.contexts() == 0) && !h.pop();
+    flag &= (P->arrowsFrom.size() == 1) && (Q->arrowsFrom.size() == 2) && (P->arrowsTo.size() == 1) && h.isArrow(P_and_Q, Q);
+    auto S = h.createElement("S");
+    flag &= (S->id == n) && (h.product({ S, Q })->id == n + 1) && !h.isArrow(S, P);
+    return flag;
+}
+
+bool Tests::test_21() {
+    /*
+     * Parse two problems that share a hypothesis, and check the formulas, the goals and the contexts they are read in
+     */
+    std::string text =
+        "# Shared by both problems\n"
+        "assume p => q\n"
+        "problem first\n"
+        "assume p\n"
+        "prove q ^ p\n"
+        "prove ~r v (s => r => t)   # comment\n"
+        "\n"
+        "problem second\n"
+        "assume true -> (q ∧ ¬p)\n"
+        "prove ⊤ => q\n";
+    
+    Heyting h;
+    Prover prover(h);
+    Parser parser(h, text.data(), text.data() + text.size());
+    Parser::Problem problem;
+    
+    bool flag = parser.next(problem) && (problem.name == "first") && (problem.goals.size() == 2) && (h.contexts() == 1);
+    flag &= (problem.lines == std::vector<size_t>({ 5, 6 }));
+    flag &= (h.to_string(problem.goals[0].second) == "p ^ q") && (problem.goals[0].first == h.True);
+    flag &= (problem.goals[1].second->type == Heyting::Element::COPRODUCT) && (problem.goals[1].second->size == 9);
+    auto results = prover.implications(problem.goals);
+    flag &= results[0] && !results[1];
+    
+    // The atom r of the first problem is gone, so the second problem creates its own
+    size_t n = h.size();
+    flag &= parser.next(problem) && (problem.name == "second") && (problem.goals.size() == 1) && (h.size() < n);
+    flag &= prover.implications(problem.goals)[0] && !parser.next(problem) && (h.contexts() == 0);
+    
+    // Syntax errors name the line
+    std::string wrong = "prove p\nassume (p ^ q\n";
+    Parser other(h, wrong.data(), wrong.data() + wrong.size());
+    try {
+        other.next(problem);
+        flag = false;
+    }
+    catch(const std::runtime_error& e) {
+        flag &= (std::string(e.what()) == "line 2: expected ')'");
+    }
+    return flag;
+}
+
+bool Tests::test_22() {
+    /*
+     * Save an algebra with all kinds of elements as an image, load it into another one,
+     * and check that the elements, the arrows (in their order) and the interning are the same
+     */
+    Heyting h1;
+    auto P = h1.createElement("P");
+    auto Q = h1.createElement("Q");
+    auto R = h1.createElement();
+    h1.putArrow(h1.product({ P, Q }), R);
+    h1.putArrow(R, h1.coproduct({ P, h1.negate(Q) }));
+    h1.putArrow(h1.True, h1.exponential(P, h1.product({ Q, R })));
+    h1.putArrow(P, Q);
+    
+    std::string path = "/tmp/automated-proving-test-22.img";
+    Store::save(h1, path);
+    
+    Heyting h2;
+    h2.indexReachability(true);
+    Store::load(h2, path);
+    
+    bool flag = (h1.size() == h2.size());
+    for(size_t i = 0;flag && i < h1.size(); ++i) {
+        auto x1 = h1.element((Heyting::Id) i), x2 = h2.element((Heyting::Id) i);
+        flag &= (x1->type == x2->type) && (x1->fingerprint == x2->fingerprint) && (h1.to_string(x1) == h2.to_string(x2));
+        flag &= (x1->arrowsTo.size() == x2->arrowsTo.size()) && (x1->arrowsFrom.size() == x2->arrowsFrom.size());
+        for(size_t j = 0;flag && j < x1->arrowsFrom.size(); ++j)
+            flag &= (x1->arrowsFrom[j]->id == x2->arrowsFrom[j]->id);
+    }
+    
+    // Interning finds the loaded elements, and the reachability index knows the loaded arrows
+    auto P2 = h2.element(P->id), Q2 = h2.element(Q->id), R2 = h2.element(R->id);
+    flag &= (h2.product({ Q2, P2 })->id == h1.product({ P, Q })->id) && (h2.exponential(P2, h2.product({ R2, Q2 }))->id == h1.exponential(P, h1.product({ Q, R }))->id);
+    flag &= h2.isArrow(h2.product({ P2, Q2 }), h2.coproduct({ P2, h2.negate(Q2) })) && h2.isArrow(P2, Q2) && !h2.isArrow(R2, P2);
+    
+    // Only into an empty algebra, and only a valid image
+    try {
+        Store::load(h2, path);
+        flag = false;
+    }
+    catch(const std::runtime_error&) {
+    }
+    std::string truncated(sizeof(uint64_t) * 6, 0);
+    try {
+        Heyting h3;
+        Store::load(h3, truncated.data(), truncated.data() + truncated.size());
+        flag = false;
+    }
+    catch(const std::runtime_error&) {
+    }
+    
+    // Nor an image with an arrow to an element that does not exist, or the same arrow twice in one list
+    // (the adjacency section comes right before the names: per element the two lengths, then the ids)
+    std::ifstream in(path, std::ios::binary);
+    std::string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint64_t elements, adjacency, names;
+    std::memcpy(&elements, &image[16], sizeof(uint64_t));
+    std::memcpy(&adjacency, &image[32], sizeof(uint64_t));
+    std::memcpy(&names, &image[40], sizeof(uint64_t));
+    size_t start = image.size() - names - adjacency * sizeof(uint32_t);
+    uint32_t list[3];
+    for(std::memcpy(list, &image[start], sizeof(list)); list[0] < 2; std::memcpy(list, &image[start], sizeof(list)))
+        start += (2 + list[0] + list[1]) * sizeof(uint32_t);
+    for(uint32_t id : { (uint32_t) elements, list[2] }) {
+        std::string corrupt = image;
+        std::memcpy(&corrupt[start + 3 * sizeof(uint32_t)], &id, sizeof(uint32_t));
+        try {
+            Heyting h3;
+            Store::load(h3, corrupt.data(), corrupt.data() + corrupt.size());
+            flag = false;
+        }
+        catch(const std::runtime_error&) {
+        }
+    }
+    std::remove(path.c_str());
+    return flag;
+}
+
+bool Tests::test_23() {
+    /*
+     * Check the products of all factors but one, which are cached in the product,
+     * also when they are created in a child context that is dropped again
+     */
+    Heyting h;
+    std::vector<Heyting::Element*> atoms;
+    for(int i = 0;i < 5; ++i)
+        atoms.push_back(h.createElement("a" + std::to_string(i)));
+    auto all = (Heyting::Product*) h.product(std::set<Heyting::Element*>(atoms.begin(), atoms.end()));
+    auto pair = (Heyting::Product*) h.product({ atoms[0], atoms[1] });
+    
+    bool flag = (all->factors.size() == 5) && all->factors.contains(atoms[3]) && !pair->factors.contains(atoms[3]);
+    flag &= (h.productWithout(pair, 0) == pair->factors[1]) && (h.productWithout(pair, 1) == pair->factors[0]);
+    for(size_t i = 0;i < 5; ++i) {
+        std::set<Heyting::Element*> rest(all->factors.begin(), all->factors.end());
+        rest.erase(all->factors[i]);
+        flag &= (h.productWithout(all, i) == h.product(rest)) && (h.productWithout(all, i) == h.productWithout(all, i));
+    }
+    
+    // The sub-products of a product created in a child context are gone with it, and created again afterwards
+    auto b = h.createElement("b");
+    size_t n;
+    {
+        Heyting::Context context(h);
+        auto big = (Heyting::Product*) h.product({ all, b });
+        n = h.size();
+        flag &= (h.productWithout(big, 5)->id == all->id) && (h.productWithout(big, 0)->id == n);
+    }
+    auto big = (Heyting::Product*) h.product({ all, b });
+    flag &= (big->id == n - 1) && (h.productWithout(big, 0)->id == n) && (h.size() == n + 1);
+    return flag;
+}
+
+bool Tests::test_24() {
+    /*
+     * Prove the same goals many times with the elements of every query reclaimed afterwards,
+     * and check that the algebra does not grow, while the implications that were shown are kept as arrows
+     */
+    Heyting h1, h2;
+    auto goals = [](Heyting& h) {
+        auto A = h.createElement("A");
+        auto B = h.createElement("B");
+        auto C = h.createElement("C");
+        h.putArrow(h.product({ A, B }), C);
+        return std::vector<Prover::Goal> {
+            Prover::Goal(A, h.exponential(A, B)),
+            Prover::Goal(h.product({ A, h.exponential(B, A) }), B),
+            Prover::Goal(A, h.exponential(C, B)),
+            Prover::Goal(h.coproduct({ A, B }), C)
+        };
+    };
+    auto goals1 = goals(h1), goals2 = goals(h2);
+    
+    Prover prover1(h1), prover2(h2);
+    prover1.setVerbose(false);
+    prover2.setVerbose(false);
+    prover2.setScratch(true);
+    
+    size_t n = h2.size();
+    bool flag = true;
+    for(int k = 0;k < 100; ++k) {
+        for(size_t i = 0;i < goals1.size(); ++i) {
+            Prover::Stats stats;
+            flag &= (prover1.implication(goals1[i].first, goals1[i].second) == prover2.implication(goals2[i].first, goals2[i].second, stats));
+            flag &= (h2.size() == n) && (h2.contexts() == 0);
+            if(k == 0 && i == 3)
+                flag &= (stats.elementsCreated > 0);
+        }
+        flag &= (prover2.implications(goals2) == std::vector<bool>({ true, true, true, false })) && (h2.size() == n);
+    }
+    flag &= h2.isArrow(goals2[0].first, goals2[0].second) && h2.isArrow(goals2[2].first, goals2[2].second);
+    return flag;
+}
+
+bool Tests::test_25() {
+    /*
+     * Given (a_i ^ c) => a_i+1 for i = 0, ..., 7, prove (a_0 ^ c) => a_8 (which takes thousands of nodes)
+     * within a node budget, an element budget, a deadline that has passed and a cancelled flag, which all give up,
+     * and then without limits, which still succeeds: giving up must not leave failures in the memo
+     * Also check that the limits stop a parallel search
+     */
+    bool flag = true;
+    for(int threads : { 1, 4 }) {
+        Heyting h;
+        auto c = h.createElement("c");
+        std::vector<Heyting::Element*> a;
+        for(int i = 0;i <= 8; ++i)
+            a.push_back(h.createElement("a" + std::to_string(i)));
+        for(int i = 0;i < 8; ++i)
+            h.putArrow(h.product({ a[i], c }), a[i + 1]);
+        auto x = h.product({ a[0], c });
+        
+        Prover prover(h);
+        prover.setVerbose(false);
+        prover.setMaxPay(8);
+        prover.setThreads(threads);
+        
+        Prover::Limits nodes;
+        nodes.nodes = 100;
+        Prover::Stats stats;
+        flag &= (prover.implication(x, a[8], nodes, stats) == Prover::GAVE_UP);
+        if(PROVER_STATS)
+            flag &= (stats.memoMisses <= 100 + (uint64_t) threads);
+        
+        Prover::Limits elements;
+        elements.elements = 20;
+        flag &= (prover.implication(x, a[8], elements) == Prover::GAVE_UP);
+        
+        Prover::Limits deadline;
+        deadline.deadline = std::chrono::steady_clock::now();
+        flag &= (prover.implication(x, a[8], deadline) == Prover::GAVE_UP);
+        
+        std::atomic<bool> cancel(true);
+        Prover::Limits cancelled;
+        cancelled.cancel = &cancel;
+        flag &= (prover.implication(x, a[8], cancelled) == Prover::GAVE_UP);
+        
+        // (in parallel, the time this search takes varies too much to run it to the end here)
+        if(threads == 1) {
+            Prover::Limits generous;
+            generous.nodes = 1000000;
+            flag &= (prover.implication(a[8], a[0], generous) == Prover::NOT_PROVED);
+            flag &= (prover.implication(x, a[8], Prover::Limits()) == Prover::PROVED);
+        }
+    }
+    return flag;
+}
+
+bool Tests::test_26() {
+    /*
+     * Submit goals to a service from several threads at once, through a queue that is much shorter than the number
+     * of goals, with futures, callbacks and limits, and check that every goal gets the same answer as a prover of its own
+     */
+    Heyting h;
+    std::vector<Heyting::Element*> p;
+    for(int i = 0;i < 6; ++i)
+        p.push_back(h.createElement("p" + std::to_string(i)));
+    for(int i = 0;i < 5; ++i)
+        h.putArrow(p[i], p[i + 1]);
+    auto x = h.product({ p[0], h.exponential(p[5], p[0]) });
+    
+    // p_i => p_j holds for i <= j, and x => p_j for all j
+    std::vector<Prover::Goal> goals;
+    std::vector<Prover::Result> expected;
+    for(int i = 0;i < 6; ++i)
+        for(int j = 0;j < 6; ++j) {
+            goals.emplace_back(p[i], p[j]);
+            expected.push_back(i <= j ? Prover::PROVED : Prover::NOT_PROVED);
+            goals.emplace_back(x, h.product({ p[j], p[i] }));
+            expected.push_back(Prover::PROVED);
+        }
+    
+    bool flag = true;
+    Service service(h, 3, 4);
+    std::vector<Prover::Result> answers(goals.size(), Prover::GAVE_UP);
+    std::vector<std::thread> clients;
+    std::atomic<size_t> answered(0);
+    for(size_t t = 0;t < 4; ++t)
+        clients.emplace_back([&, t]() {
+            for(size_t i = t;i < goals.size(); i += 4) {
+                if(i % 8 < 4)
+                    answers[i] = service.submit(goals[i].first, goals[i].second).get();
+                else
+                    service.submit(goals[i].first, goals[i].second, [&answers, &answered, i](Prover::Result r) { answers[i] = r; ++answered; });
+            }
+        });
+    for(auto& c : clients)
+        c.join();
+    service.wait();
+    flag &= (service.pending() == 0);
+    flag &= (answers == expected);
+    flag &= (answered == goals.size() / 2);
+    
+    // Goals with limits keep them, and a full queue refuses goals
+    std::atomic<bool> cancel(true);
+    Prover::Limits cancelled;
+    cancelled.cancel = &cancel;
+    flag &= (service.submit(p[5], p[0], cancelled).get() == Prover::GAVE_UP);
+    
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool blocked = true;
+    std::atomic<int> started(0);
+    for(int i = 0;i < 3; ++i)
+        service.submit(p[i], p[5], [&](Prover::Result) {
+            ++started;
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return !blocked; });
+        });
+    while(started < 3)
+        std::this_thread::yield();
+    for(int i = 0;i < 4; ++i)
+        flag &= service.trySubmit(p[0], p[1], nullptr);
+    flag &= !service.trySubmit(p[0], p[1], nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocked = false;
+    }
+    condition.notify_all();
+    service.wait();
+    flag &= (service.pending() == 0);
+    
+    // A callback that throws is called once, and the worker goes on with the next goals
+    std::atomic<int> calls(0);
+    service.submit(p[0], p[1], [&calls](Prover::Result) {
+        ++calls;
+        throw std::runtime_error("callback");
+    });
+    flag &= (service.submit(p[1], p[2]).get() == Prover::PROVED);
+    service.wait();
+    flag &= (calls == 1);
+    
+    // A service shares the algebra like any other user, and leaves it shared for the others when it goes
+    Heyting g;
+    Prover prover(g);
+    prover.setThreads(2);
+    {
+        Service other(g, 1, 1);
+    }
+    flag &= g.isConcurrent();
+    prover.setThreads(1);
+    flag &= !g.isConcurrent();
+    return flag;
+}
+
+bool Tests::test_27() {
+    /*
+     * Check the SAT solver on pigeonhole formulas (n + 1 pigeons do not fit into n holes, n pigeons do),
+     * and check that the prover refutes the goals with a classical countermodel without searching,
+     * but not the ones that hold classically (whether or not they can be shown)
+     */
+    bool flag = true;
+    for(int n = 2;n <= 5; ++n)
+        for(int pigeons : { n, n + 1 }) {
+            Solver solver;
+            std::vector<std::vector<Solver::Variable>> in(pigeons);
+            for(auto& row : in)
+                for(int j = 0;j < n; ++j)
+                    row.push_back(solver.addVariable());
+            for(auto& row : in) {
+                std::vector<Solver::Literal> some;
+                for(auto v : row)
+                    some.push_back(Solver::literal(v));
+                solver.addClause(some);
+            }
+            for(int j = 0;j < n; ++j)
+                for(int a = 0;a < pigeons; ++a)
+                    for(int b = a + 1;b < pigeons; ++b)
+                        solver.addClause({ Solver::literal(in[a][j], true), Solver::literal(in[b][j], true) });
+            
+            auto result = solver.solve();
+            flag &= (result == (pigeons > n ? Solver::UNSATISFIABLE : Solver::SATISFIABLE));
+            if(result == Solver::SATISFIABLE)
+                for(int j = 0;j < n; ++j) {
+                    int count = 0;
+                    for(auto& row : in)
+                        count += solver.modelValue(row[j]);
+                    flag &= (count == 1);
+                }
+            
+            // With an assumption that contradicts the clauses the answer changes, but only for that call
+            if(pigeons == n) {
+                flag &= (solver.solve({ Solver::literal(in[0][0]), Solver::literal(in[1][0]) }) == Solver::UNSATISFIABLE);
+                flag &= (solver.solve() == Solver::SATISFIABLE);
+            }
+        }
+    
+    Heyting h;
+    auto p = h.createElement("p");
+    auto q = h.createElement("q");
+    Prover prover(h);
+    prover.setVerbose(false);
+    prover.setRefutation(true);
+    
+    Prover::Stats stats;
+    flag &= !prover.implication(p, q, stats);
+    flag &= (stats.refuted == 1 && stats.rounds == 0);
+    flag &= !prover.implication(h.coproduct({ p, q }), p, stats);
+    flag &= (stats.refuted == 1);
+    
+    // This one holds classically, and in all frames the Kripke models use (but not in a chain of three worlds),
+    // so it is searched for (and not found)
+    flag &= !prover.implication(h.True, h.coproduct({ q, h.exponential(h.coproduct({ p, h.negate(p) }), q) }), stats);
+    flag &= (stats.refuted == 0 && stats.rounds > 0);
+    flag &= prover.implication(h.product({ p, h.exponential(q, p) }), q, stats);
+    
+    // New arrows are taken into account, and cleared ones are forgotten again
+    h.putArrow(q, p);
+    flag &= prover.implication(h.coproduct({ p, q }), p, stats);
+    flag &= (stats.refuted == 0);
+    h.clearArrows();
+    flag &= !prover.implication(h.coproduct({ p, q }), p, stats);
+    flag &= (stats.refuted == 1);
+    
+    // If the hypotheses have no valuation at all, nothing is refuted
+    h.putArrow(h.True, p);
+    h.putArrow(p, h.False);
+    auto results = prover.implications({ { q, p }, { p, q } }, stats);
+    flag &= (results == std::vector<bool>({ true, true }));
+    flag &= (stats.refuted == 0);
+    return flag;
+}
+
+bool Tests::test_28() {
+    /*
+     * Check which frame refutes classical and intuitionistic non-theorems (and that theorems are not refuted),
+     * that arrows rule out the valuations that do not respect them, and that the atoms beyond the ones
+     * that run through all combinations still get countermodels from the random lanes
+     */
+    Heyting h;
+    auto p = h.createElement("p");
+    auto q = h.createElement("q");
+    Countermodels models(h, 64);
+    
+    bool flag = true;
+    flag &= (models.refutes(p, q) == Countermodels::CLASSICAL);
+    flag &= (models.refutes(h.True, h.coproduct({ p, h.negate(p) })) == Countermodels::CHAIN);
+    flag &= (models.refutes(h.negate(h.negate(p)), p) == Countermodels::CHAIN);
+    flag &= (models.refutes(h.True, h.coproduct({ h.exponential(q, p), h.exponential(p, q) })) == Countermodels::FORK);
+    flag &= (models.refutes(h.True, h.coproduct({ h.negate(p), h.negate(h.negate(p)) })) == Countermodels::FORK);
+    flag &= (models.refutes(p, h.negate(h.negate(p))) == Countermodels::NONE);
+    flag &= (models.refutes(h.product({ p, h.exponential(q, p) }), q) == Countermodels::NONE);
+    flag &= (models.refutes(h.exponential(h.False, p), h.negate(p)) == Countermodels::NONE);
+    
+    h.putArrow(h.True, h.coproduct({ p, h.negate(p) }));
+    flag &= (models.refutes(h.negate(h.negate(p)), p) == Countermodels::NONE);
+    h.putArrow(p, q);
+    flag &= (models.refutes(p, q) == Countermodels::NONE);
+    flag &= (models.refutes(q, p) == Countermodels::CLASSICAL);
+    h.clearArrows();
+    flag &= (models.refutes(h.negate(h.negate(p)), p) == Countermodels::CHAIN);
+    
+    std::vector<Heyting::Element*> r;
+    for(int i = 0;i < 20; ++i)
+        r.push_back(h.createElement("r" + std::to_string(i)));
+    flag &= (models.refutes(r[19], r[18]) == Countermodels::CLASSICAL);
+    flag &= (models.refutes(h.True, h.coproduct({ r[19], h.negate(r[19]) })) == Countermodels::CHAIN);
+    flag &= (models.refutes(h.product({ r[18], r[19] }), r[19]) == Countermodels::NONE);
+    
+    // The prover does not search for goals that fail in one of the models
+    Prover prover(h);
+    prover.setVerbose(false);
+    prover.setRefutation(true);
+    Prover::Stats stats;
+    flag &= !prover.implication(h.negate(h.negate(p)), p, stats);
+    flag &= (stats.refuted == 1 && stats.rounds == 0);
+    return flag;
+}
+
+bool Tests::test_29() {
+    /*
+     * Load the same random algebra (with cycles, and products and coproducts created in between) arrow by arrow
+     * and in bulk, and check that isArrow answers the same from the index built at the end as the search does,
+     * also after more arrows are put, and that rolling back removes the arrows added in bulk
+     */
+    bool flag = true;
+    for(int bulk = 0;bulk < 2; ++bulk) {
+        Heyting h, reference;
+        std::mt19937 random(3);
+        std::vector<Heyting::Element*> x, y;
+        for(int i = 0;i < 40; ++i) {
+            x.push_back(h.createElement("p" + std::to_string(i)));
+            y.push_back(reference.createElement("p" + std::to_string(i)));
+        }
+        
+        auto snapshot = h.snapshot();
+        if(bulk)
+            h.beginBulk();
+        for(int k = 0;k < 120; ++k) {
+            size_t a = random() % x.size(), b = random() % x.size();
+            switch(random() % 8) {
+                case 0:
+                    x.push_back(h.product({ x[a], x[b] }));
+                    y.push_back(reference.product({ y[a], y[b] }));
+                    break;
+                case 1:
+                    x.push_back(h.coproduct({ x[a], x[b] }));
+                    y.push_back(reference.coproduct({ y[a], y[b] }));
+                    break;
+                case 2:
+                    h.putArrow(h.True, x[a]);
+                    reference.putArrow(reference.True, y[a]);
+                    break;
+                default:
+                    h.putArrow(x[a], x[b]);
+                    reference.putArrow(y[a], y[b]);
+                    break;
+            }
+        }
+        h.putArrow(x[7], h.False);
+        reference.putArrow(y[7], reference.False);
+        if(bulk)
+            h.endBulk();
+        else
+            h.indexReachability(true);
+        
+        auto compare = [&]() {
+            bool same = (h.size() == reference.size());
+            for(size_t i = 0;i < h.size(); ++i)
+                for(size_t j = 0;j < h.size(); ++j)
+                    same &= (h.isArrow(h.element((Heyting::Id) i), h.element((Heyting::Id) j)) == reference.isArrow(reference.element((Heyting::Id) i), reference.element((Heyting::Id) j)));
+            return same;
+        };
+        flag &= compare();
+        
+        h.putArrow(x[1], x[2]);
+        reference.putArrow(y[1], y[2]);
+        flag &= compare();
+        
+        flag &= h.rollback(snapshot);
+        flag &= !h.isArrow(x[7], h.False);
+        flag &= !h.isArrow(x[1], x[2]);
+    }
+    return flag;
+}
+
+bool Tests::test_30() {
+    /*
+     * Check that equal products, coproducts and exponentials are one and the same element,
+     * however their factors are ordered or nested, and that they can be looked up without creating them
+     */
+    Heyting h;
+    
+    auto P = h.createElement("P");
+    auto Q = h.createElement("Q");
+    auto R = h.createElement("R");
+    
+    bool flag = true;
+    flag &= (h.product({ P, Q, R }, false) == nullptr) && (h.coproduct({ P, Q }, false) == nullptr) && (h.exponential(P, Q, false) == nullptr);
+    
+    auto prod = h.product({ P, Q, R });
+    auto coprod = h.coproduct({ R, P });
+    auto exp = h.exponential(P, Q);
+    size_t size = h.size();
+    
+    // Many other elements in between, so that the hash indices grow
+    for(int i = 0;i < 1000; ++i) {
+        auto S = h.createElement();
+        h.product({ P, S });
+        h.coproduct({ Q, S });
+        h.exponential(S, R);
+    }
+    
+    flag &= (h.product({ R, Q, P }) == prod) && (h.product({ h.product({ Q, R }), P, h.True }) == prod) && (h.product({ P, Q, R }, false) == prod);
+    flag &= (h.coproduct({ P, R }) == coprod) && (h.coproduct({ h.False, R, P }, false) == coprod);
+    flag &= (h.exponential(P, Q) == exp) && (h.exponential(P, Q, false) == exp);
+    flag &= (h.exponential(h.exponential(P, R), Q) == h.exponential(P, h.product({ Q, R })));
+    
+    // The ids stay those given at creation
+    flag &= (h.element(prod->id) == prod) && (h.element(coprod->id) == coprod) && (h.element(exp->id) == exp) && (prod->id < size);
+    return flag;
+}
+
+bool Tests::test_31() {
+    /*
+     * Check that memory released back to a mark of the arena is handed out again, also across blocks,
+     * and that elements created after a child context is dropped take over the ids and memory of its elements
+     */
+    bool flag = true;
+    {
+        Arena arena(256);
+        arena.allocate(24, 8);
+        auto mark = arena.mark();
+        void* first = arena.allocate(40, 8);
+        for(int i = 0;i < 100; ++i)
+            arena.allocate(40, 8);
+        void* large = arena.allocate(1000, 16);
+        flag &= (((size_t) large & 15) == 0);
+        
+        arena.release(mark);
+        flag &= (arena.allocate(40, 8) == first);
+        for(int i = 0;i < 100; ++i)
+            arena.allocate(40, 8);
+        arena.release(mark);
+        flag &= (arena.allocate(40, 8) == first);
+    }
+    
+    Heyting h;
+    auto P = h.createElement("P");
+    auto Q = h.createElement("Q");
+    size_t size = h.size();
+    for(int round = 0;round < 3; ++round) {
+        Heyting::Element* created;
+        Heyting::Element* product;
+        {
+            Heyting::Context context(h);
+            created = h.createElement("R");
+            product = h.product({ P, Q, created });
+            for(int i = 0;i < 1000; ++i)
+                h.exponential(h.createElement(), P);
+        }
+        flag &= (h.size() == size);
+        
+        // Again in a child context, to leave the algebra as it was for the next round
+        Heyting::Context context(h);
+        auto R = h.createElement("R");
+        flag &= (R == created) && (R->id == size) && (h.element(R->id) == R) && (h.name(R) == "R");
+        flag &= (h.product({ P, Q, R }) == product) && (product->id == size + 1);
+    }
+    return flag;
+}
+
+bool Tests::test_32() {
+    /*
+     * Insert into, look up in and erase from adjacencies around the size at which they start hashing,
+     * and check them against a std::set (and against the order of insertion)
+     */
+    bool flag = true;
+    std::mt19937 random(5);
+    std::vector<int> values(200);
+    
+    for(int round = 0;round < 20; ++round) {
+        Adjacency<int*> adjacency;
+        std::set<int*> reference;
+        std::vector<int*> order;
+        
+        // Grow past the threshold, shrink back below it, and grow again
+        for(size_t limit : { (size_t) 40, (size_t) 5, (size_t) 150, (size_t) 0, (size_t) 17 }) {
+            while(reference.size() != limit) {
+                int* x = &values[random() % values.size()];
+                if(reference.size() < limit) {
+                    bool inserted = reference.insert(x).second;
+                    flag &= (adjacency.insert(x) == inserted);
+                    if(inserted)
+                        order.push_back(x);
+                }
+                else {
+                    // Mostly entries that are there, sometimes ones that are not
+                    if(random() % 4 != 0)
+                        x = order[random() % order.size()];
+                    bool erased = reference.erase(x) > 0;
+                    flag &= (adjacency.erase(x) == erased);
+                    if(erased)
+                        order.erase(std::find(order.begin(), order.end(), x));
+                }
+                
+                for(size_t i = 0;i < values.size(); i += 7)
+                    flag &= (adjacency.contains(&values[i]) == (reference.count(&values[i]) > 0));
+            }
+            flag &= (adjacency.size() == order.size()) && std::equal(order.begin(), order.end(), adjacency.begin());
+            for(auto x : order)
+                flag &= adjacency.contains(x);
+        }
+    }
+    return flag;
+}
+
+bool Tests::test_33() {
+    /*
+     * Given (a ^ b) => c and c => b
+     *
+     * Check that a failure which was not cut off for lack of pay is final: rounds with more pay
+     * after it do not search for (unprovable) a => c again
+     */
+    uint64_t nodes[2] = { 0, 0 };
+    bool flag = true;
+    for(int attempt = 0;attempt < 2; ++attempt) {
+        Heyting h;
+        auto a = h.createElement("a");
+        auto b = h.createElement("b");
+        auto c = h.createElement("c");
+        h.putArrow(h.product({ a, b }), c);
+        h.putArrow(c, b);
+        
+        Prover prover(h);
+        if(attempt == 0)
+            prover.setPaySchedule({ 3 });
+        else
+            prover.setPaySchedule({ 3, 4, 5, 6 });
+        
+        Prover::Stats stats;
+        flag &= !prover.implication(a, c, stats);
+        for(auto n : stats.nodes)
+            nodes[attempt] += n;
+    }
+    if(PROVER_STATS)
+        flag &= (nodes[0] > 0 && nodes[1] == nodes[0]);
+    return flag;
+}
+
+bool Tests::test_34() {
+    /*
+     * A snapshot taken after a point the log has been rolled back past no longer applies, even once the log
+     * has grown past it again; and releasing the last snapshot drops the log
+     */
+    Heyting h;
+    auto A = h.createElement("A");
+    auto B = h.createElement("B");
+    auto C = h.createElement("C");
+    auto D = h.createElement("D");
+    auto E = h.createElement("E");
+    auto F = h.createElement("F");
+    
+    auto s1 = h.snapshot();
+    h.putArrow(A, B);
+    auto s2 = h.snapshot();
+    bool flag = h.rollback(s1);
+    h.putArrow(C, D);
+    h.putArrow(E, F);
+    flag &= !h.rollback(s2) && h.isArrow(C, D) && h.isArrow(E, F) && !h.isArrow(A, B);
+    
+    // Rolling back to the same snapshot twice, or to an earlier one after a later one, is fine
+    auto s3 = h.snapshot();
+    h.putArrow(A, B);
+    flag &= h.rollback(s3) && h.rollback(s3) && !h.isArrow(A, B) && h.rollback(s1) && !h.isArrow(C, D);
+    
+    // s3 lies past the point that s1 rolled back to, and once all snapshots are released, s1 cannot be rolled
+    // back to either (the log is gone)
+    h.release(s2);
+    h.release(s3);
+    h.putArrow(A, B);
+    flag &= !h.rollback(s3) && h.rollback(s1) && !h.isArrow(A, B);
+    h.release(s1);
+    h.putArrow(C, D);
+    flag &= !h.rollback(s1) && h.isArrow(C, D);
+    
+    // A child context still undoes its own arrows, with a snapshot taken inside it or not
+    {
+        Heyting::Context context(h);
+        auto s4 = h.snapshot();
+        h.putArrow(E, F);
+        h.release(s4);
+    }
+    flag &= !h.isArrow(E, F) && h.isArrow(C, D);
+    return flag;
+}
+
+bool Tests::test_35() {
+    /*
+     * Check that product and coproduct give the same elements for a vector of factors (in any order, with
+     * repetitions, True, False and nested products and coproducts) as for the set of the same factors
+     */
+    Heyting h;
+    std::vector<Heyting::Element*> pool { h.True, h.False };
+    for(int i = 0;i < 6; ++i)
+        pool.push_back(h.createElement("p" + std::to_string(i)));
+    
+    std::mt19937 random(5);
+    bool flag = true;
+    std::vector<Heyting::Element*> factors;
+    for(int k = 0;k < 400; ++k) {
+        factors.clear();
+        size_t n = random() % 5;
+        for(size_t i = 0;i < n; ++i)
+            factors.push_back(pool[random() % pool.size()]);
+        std::set<Heyting::Element*> set(factors.begin(), factors.end());
+        
+        // The vector comes first, so that it has to create the element as often as the set would
+        Heyting::Element* x;
+        if(k % 2 == 0) {
+            x = h.product(factors);
+            flag &= (h.product(set, false) == x);
+        }
+        else {
+            x = h.coproduct(factors);
+            flag &= (h.coproduct(set, false) == x);
+        }
+        pool.push_back(x);
+    }
+    return flag;
+}
+
+bool Tests::test_36() {
+    /*
+     * Check that the rules in their tuned order show the same goals as in the fixed order, on random theories
+     * with plain elements, products and exponentials, and that no goal they show has a countermodel
+     */
+    bool flag = true;
+    size_t shown = 0, goals = 0;
+    for(unsigned seed = 1;seed <= 12; ++seed) {
+        bool results[2][24];
+        for(int tuned = 0;tuned < 2; ++tuned) {
+            Heyting h;
+            std::mt19937 random(seed);
+            std::vector<Heyting::Element*> x;
+            for(int i = 0;i < 5; ++i)
+                x.push_back(h.createElement("p" + std::to_string(i)));
+            auto formula = [&]() {
+                auto a = x[random() % x.size()], b = x[random() % x.size()];
+                switch(random() % 3) {
+                    case 0: return h.product({ a, b });
+                    case 1: return h.exponential(a, b);
+                    default: return a;
+                }
+            };
+            for(int i = 0;i < 6; ++i)
+                h.putArrow(formula(), formula());
+            
+            // Within a query, the failures in the memo depend on the order in which the subgoals came up,
+            // so with more pay an order may show a goal the other one misses
+            Prover prover(h);
+            prover.setVerbose(false);
+            prover.setTunedRules(tuned == 1);
+            prover.setPaySchedule({ 0, 1 });
+            Countermodels countermodels(h);
+            for(int i = 0;i < 24; ++i) {
+                auto a = formula(), b = formula();
+                bool refuted = (countermodels.refutes(a, b) != Countermodels::NONE);
+                results[tuned][i] = prover.implication(a, b);
+                flag &= !(refuted && results[tuned][i]);
+            }
+        }
+        for(int i = 0;i < 24; ++i) {
+            flag &= (results[0][i] == results[1][i]);
+            shown += results[1][i];
+            ++goals;
+        }
+    }
+    // Both outcomes occur
+    return flag && shown > 0 && shown < goals;
+}
+
+bool Tests::test_37() {
+    /*
+     * Reclaim child contexts under provers that share the algebra, and check that only what involved the reclaimed
+     * elements is forgotten: the generation stays, other provers keep their memo, the index forgets the paths through
+     * the reclaimed elements only, an id given to a new element is a new element to the memo, and arrows that were kept
+     * to an element that lost others are still seen by the countermodels
+     */
+    Heyting h;
+    h.indexReachability(true);
+    auto a = h.createElement("a");
+    auto b = h.createElement("b");
+    auto c = h.createElement("c");
+    auto y = h.createElement("y");
+    auto a_and_b = h.product({ a, b });
+    auto b_and_c = h.product({ b, c });
+    auto all = h.product({ a, b, c });
+    auto goal = std::make_pair(h.product({ a, h.exponential(b, a) }), b);
+    uint64_t generation = h.generation();
+    
+    Prover other(h), refuting(h);
+    other.setVerbose(false);
+    refuting.setVerbose(false);
+    refuting.setRefutation(true);
+    Prover::Stats first, second;
+    bool flag = other.implication(goal.first, goal.second, first) && !refuting.implication(b_and_c, y);
+    
+    h.push();
+    size_t mark = h.size();
+    auto N = h.createElement("N");
+    h.putArrow(a_and_b, N);
+    h.putArrow(N, c);
+    h.putArrow(N, y);
+    h.putArrow(c, b);
+    flag &= h.isArrow(a_and_b, c) && !h.isArrow(all, N) && other.implication(all, N) && !refuting.implication(b_and_c, y);
+    h.putArrow(b, y);
+    size_t created = h.size() - mark;
+    flag &= (created > 1) && (h.reclaim() == created) && (h.generation() == generation) && (h.size() == mark);
+    
+    // The index answers like the search does: a ^ b no longer reaches c through N, c => b was kept
+    flag &= !h.isArrow(a_and_b, c) && !h.isArrow(a, b) && h.isArrow(c, b) && h.isArrow(c, y) && h.isArrow(b_and_c, y);
+    std::vector<bool> indexed;
+    for(Heyting::Id i = 0;i < h.size(); ++i)
+        for(Heyting::Id j = 0;j < h.size(); ++j)
+            indexed.push_back(h.isArrow(h.element(i), h.element(j)));
+    h.indexReachability(false);
+    size_t k = 0;
+    for(Heyting::Id i = 0;i < h.size(); ++i)
+        for(Heyting::Id j = 0;j < h.size(); ++j)
+            flag &= (indexed[k++] == h.isArrow(h.element(i), h.element(j)));
+    h.indexReachability(true);
+    
+    // The other prover still has its attempts, but not the one with N, whose id M has got by then
+    auto M = h.createElement("M");
+    flag &= other.implication(goal.first, goal.second, second);
+    if(PROVER_STATS) {
+        uint64_t before = 0, after = 0;
+        for(auto n : first.nodes)
+            before += n;
+        for(auto n : second.nodes)
+            after += n;
+        flag &= (after < before);
+    }
+    flag &= (M->id == mark) && !other.implication(all, M);
+    
+    // b => y was put after the countermodels had taken the arrows to y into account, and it is still there
+    flag &= refuting.implication(b_and_c, y);
+    return flag;
+}
@@ -15,6 +15,34 @@ class Tests {
     static bool test_7();
     static bool test_8();
     static bool test_9();
+    static bool test_10();
+    static bool test_11();
+    static bool test_12();
+    static bool test_13();
+    static bool test_14();
+    static bool test_15();
+    static bool test_16();
+    static bool test_17();
+    static bool test_18();
+    static bool test_19();
+    static bool test_20();
+    static bool test_21();
+    static bool test_22();
+    static bool test_23();
+    static bool test_24();
+    static bool test_25();
+    static bool test_26();
+    static bool test_27();
+    static bool test_28();
+    static bool test_29();
+    static bool test_30();
+    static bool test_31();
+    static bool test_32();
+    static bool test_33();
+    static bool test_34();
+    static bool test_35();
+    static bool test_36();
+    static bool test_37();
     
 public:
     
@@ -0,0 +1,100 @@
+#include "threadpool.hpp"
+
+// The pool and queue of the worker running on the current thread (if any)
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local size_t currentQueue = 0;
+
+ThreadPool::ThreadPool(size_t n) : pending(0), next(0), stopping(false) {
+    if(n == 0)
+        n = 1;
+    for(size_t i = 0;i < n; ++i)
+        queues.emplace_back(new Queue());
+    for(size_t i = 0;i < n; ++i)
+        threads.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for(auto& t : threads)
+        t.join();
+}
+
+size_t ThreadPool::self() {
+    // Threads outside the pool have no queue of their own
+    return currentPool == this ? currentQueue : queues.size();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Workers push onto their own queue, other threads distribute tasks round-robin
+    size_t i = self();
+    if(i == queues.size())
+        i = next++ % queues.size();
+    
+    {
+        std::lock_guard<std::mutex> lock(queues[i]->mutex);
+        queues[i]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++pending;
+    }
+    condition.notify_one();
+    progress.notify_all();
+}
+
+bool ThreadPool::help() {
+    size_t i = self();
+    size_t n = queues.size();
+    std::function<void()> task;
+    
+    // First look at the own queue (newest task first)
+    if(i < n) {
+        std::lock_guard<std::mutex> lock(queues[i]->mutex);
+        if(!queues[i]->tasks.empty()) {
+            task = std::move(queues[i]->tasks.back());
+            queues[i]->tasks.pop_back();
+        }
+    }
+    
+    // Otherwise steal from another queue (oldest task first)
+    for(size_t k = 1;!task && k <= n; ++k) {
+        Queue& q = *queues[(i + k) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(!q.tasks.empty()) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+    }
+    
+    if(!task)
+        return false;
+    
+    --pending;
+    task();
+    
+    // Under the mutex, so that a thread in wait cannot miss it between checking its condition and sleeping
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    progress.notify_all();
+    return true;
+}
+
+void ThreadPool::work(size_t i) {
+    currentPool = this;
+    currentQueue = i;
+    
+    while(true) {
+        if(help())
+            continue;
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return stopping || pending > 0; });
+        if(stopping && pending == 0)
+            return;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef threadpool_hpp
+#define threadpool_hpp
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <chrono>
+
+/*
+ * A pool of worker threads with one task queue per worker. Workers take tasks from the back of their own queue,
+ * and steal from the front of the queues of other workers when they run out.
+ */
+class ThreadPool {
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::condition_variable progress;   // Signalled whenever a task is submitted or finishes, for the threads in wait
+    std::atomic<size_t> pending;
+    std::atomic<size_t> next;
+    bool stopping;
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    size_t self();
+    void work(size_t);
+    
+public:
+    
+    ThreadPool(size_t);
+    ~ThreadPool();
+    
+    size_t size() const { return threads.size(); }
+    
+    void submit(std::function<void()>);
+    bool help();
+    
+    // Wait until the given condition holds, running pending tasks in the meantime
+    // (with nothing to run, the thread sleeps until a task is submitted or finishes; the timeout only guards
+    // against conditions that change without a task finishing)
+    template<class Condition>
+    void wait(Condition done) {
+        while(!done()) {
+            if(help())
+                continue;
+            
+            std::unique_lock<std::mutex> lock(mutex);
+            if(pending == 0 && !done())
+                progress.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+    
+};
+
+#endif